@@ -0,0 +1,105 @@
+//
+//  CapacityPlan.cpp
+//  CloudSim
+//
+
+#include "CapacityPlan.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+
+static const char * CPU_NAMES[] = {"ARM", "POWER", "RISCV", "X86"};
+
+bool CapacityPlan::Load(const string & path, string & error) {
+    FILE * in = fopen(path.c_str(), "r");
+    if (in == nullptr) {
+        error = "cannot open " + path;
+        return false;
+    }
+
+    char buffer[256];
+    unsigned line = 0;
+    bool ok = true;
+    while (ok && fgets(buffer, sizeof(buffer), in) != nullptr) {
+        line++;
+        char * text = buffer + strspn(buffer, " \t");
+        if (*text == '#' || *text == '\n' || *text == '\r' || *text == '\0') {
+            continue;
+        }
+        CapacityStep_t step;
+        uint64_t start;
+        char cpu[16];
+        if (sscanf(text, "%" SCNu64 " %15s %u %u %lf", &start, cpu, &step.machines, &step.slots, &step.tasks) != 5) {
+            error = path + ":" + to_string(line) + ": expected start cpu machines slots tasks";
+            ok = false;
+            break;
+        }
+        step.start = start;
+        unsigned c = 0;
+        while (c < 4 && strcmp(cpu, CPU_NAMES[c]) != 0) {
+            c++;
+        }
+        if (c == 4) {
+            error = path + ":" + to_string(line) + ": unknown CPU type " + cpu;
+            ok = false;
+        } else if (!steps[c].empty() && steps[c].back().start >= step.start) {
+            error = path + ":" + to_string(line) + ": step out of order";
+            ok = false;
+        } else {
+            step.cpu = CPUType_t(c);
+            steps[c].push_back(step);
+        }
+    }
+    fclose(in);
+    return ok;
+}
+
+bool CapacityPlan::Write(const string & path, const string & comment) const {
+    FILE * out = fopen(path.c_str(), "w");
+    if (out == nullptr) {
+        return false;
+    }
+    fprintf(out, "# %s\n# start cpu machines slots tasks\n", comment.c_str());
+    for (unsigned c = 0; c < 4; c++) {
+        for (const CapacityStep_t & step : steps[c]) {
+            fprintf(out, "%" PRIu64 " %s %u %u %.1f\n", (uint64_t)step.start, CPU_NAMES[c], step.machines, step.slots, step.tasks);
+        }
+    }
+    return fclose(out) == 0;
+}
+
+bool CapacityPlan::Empty() const {
+    return Steps() == 0;
+}
+
+unsigned CapacityPlan::Steps() const {
+    unsigned count = 0;
+    for (unsigned c = 0; c < 4; c++) {
+        count += steps[c].size();
+    }
+    return count;
+}
+
+static vector<CapacityStep_t>::const_iterator after(const vector<CapacityStep_t> & plan, Time_t time) {
+    return upper_bound(plan.begin(), plan.end(), time, [](Time_t t, const CapacityStep_t & step) {
+        return t < step.start;
+    });
+}
+
+CapacityStep_t CapacityPlan::At(CPUType_t cpu, Time_t time) const {
+    auto next = after(steps[cpu], time);
+    if (next == steps[cpu].begin()) {
+        return {0, cpu, 0, 0, 0};
+    }
+    return *(next - 1);
+}
+
+unsigned CapacityPlan::Peak(CPUType_t cpu, Time_t from, Time_t to) const {
+    unsigned peak = 0;
+    for (auto step = after(steps[cpu], from); step != steps[cpu].end() && step->start <= to; step++) {
+        peak = max(peak, step->slots);
+    }
+    return peak;
+}
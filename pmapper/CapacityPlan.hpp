@@ -0,0 +1,58 @@
+//
+//  CapacityPlan.hpp
+//  CloudSim
+//
+//  A time-indexed capacity plan: for each CPU type, the task slots to keep
+//  awake from a given time on, the fewest machines that give them and the
+//  tasks the plan expects to be running. capplan (see capplan/CapPlan.cpp)
+//  builds one offline from a workload file; the scheduler loads it at Init
+//  and follows it.
+//
+//  On disk it is text, one step per line, written only where the slots
+//  change (or the expected tasks drift):
+//
+//      # comment
+//      start cpu machines slots tasks
+//      5000000 X86 12 96 81.4
+//
+
+#ifndef CapacityPlan_hpp
+#define CapacityPlan_hpp
+
+#include <string>
+#include <vector>
+
+#include "Interfaces.h"
+
+typedef struct {
+    Time_t start;
+    CPUType_t cpu;
+    unsigned machines;
+    unsigned slots;
+    double tasks;
+} CapacityStep_t;
+
+class CapacityPlan {
+public:
+    CapacityPlan()              {}
+    // steps of a CPU type have to be added in time order
+    void Add(const CapacityStep_t & step)           { steps[step.cpu].push_back(step); }
+
+    // false (with a message in error) on a line that does not parse or a
+    // step out of order
+    bool Load(const string & path, string & error);
+    bool Write(const string & path, const string & comment) const;
+
+    bool Empty() const;
+    bool Covers(CPUType_t cpu) const                { return !steps[cpu].empty(); }
+    // the step in effect at time, an empty one before the first
+    CapacityStep_t At(CPUType_t cpu, Time_t time) const;
+    // most slots any step starting in (from, to] asks for
+    unsigned Peak(CPUType_t cpu, Time_t from, Time_t to) const;
+    unsigned Steps() const;
+
+private:
+    vector<CapacityStep_t> steps[4];                // by CPUType_t
+};
+
+#endif /* CapacityPlan_hpp */
@@ -0,0 +1,215 @@
+//
+//  ClusterTable.cpp
+//  CloudSim
+//
+
+#include "ClusterTable.hpp"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CLUSTER_TABLE_X86
+#endif
+
+typedef unsigned (*FeasibleKernel_t)(const int32_t * cpu, const int32_t * memory, const int32_t * slots, const int32_t * pool,
+                                     unsigned n, int32_t want_cpu, int32_t need, int32_t pool_mask, unsigned * out, unsigned max_out);
+
+// reference version, and the tail of the vector ones
+static unsigned feasibleScalar(const int32_t * cpu, const int32_t * memory, const int32_t * slots, const int32_t * pool,
+                               unsigned n, int32_t want_cpu, int32_t need, int32_t pool_mask, unsigned * out, unsigned max_out) {
+    unsigned count = 0;
+    for (unsigned i = 0; i < n && count < max_out; i++) {
+        if (cpu[i] == want_cpu && memory[i] >= need && slots[i] >= 0 && (pool[i] & pool_mask) != 0) {
+            out[count++] = i;
+        }
+    }
+    return count;
+}
+
+#ifdef CLUSTER_TABLE_X86
+// appends the rows set in a movemask to out, lowest first
+static inline unsigned emitRows(unsigned bits, unsigned base, unsigned * out, unsigned count, unsigned max_out) {
+    while (bits != 0 && count < max_out) {
+        out[count++] = base + __builtin_ctz(bits);
+        bits &= bits - 1;
+    }
+    return count;
+}
+
+static unsigned feasibleSSE2(const int32_t * cpu, const int32_t * memory, const int32_t * slots, const int32_t * pool,
+                             unsigned n, int32_t want_cpu, int32_t need, int32_t pool_mask, unsigned * out, unsigned max_out) {
+    const __m128i vcpu = _mm_set1_epi32(want_cpu);
+    const __m128i vneed = _mm_set1_epi32(need - 1);
+    const __m128i vneg = _mm_set1_epi32(-1);
+    const __m128i vpool = _mm_set1_epi32(pool_mask);
+    const __m128i zero = _mm_setzero_si128();
+
+    unsigned count = 0;
+    unsigned i = 0;
+    for (; i + 4 <= n && count < max_out; i += 4) {
+        __m128i ok = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(cpu + i)), vcpu);
+        ok = _mm_and_si128(ok, _mm_cmpgt_epi32(_mm_loadu_si128((const __m128i *)(memory + i)), vneed));
+        ok = _mm_and_si128(ok, _mm_cmpgt_epi32(_mm_loadu_si128((const __m128i *)(slots + i)), vneg));
+        __m128i outside = _mm_cmpeq_epi32(_mm_and_si128(_mm_loadu_si128((const __m128i *)(pool + i)), vpool), zero);
+        ok = _mm_andnot_si128(outside, ok);
+        count = emitRows(_mm_movemask_ps(_mm_castsi128_ps(ok)), i, out, count, max_out);
+    }
+    if (i < n && count < max_out) {
+        unsigned tail = feasibleScalar(cpu + i, memory + i, slots + i, pool + i, n - i, want_cpu, need, pool_mask, out + count, max_out - count);
+        for (unsigned t = 0; t < tail; t++) {
+            out[count + t] += i;
+        }
+        count += tail;
+    }
+    return count;
+}
+
+__attribute__((target("avx2")))
+static unsigned feasibleAVX2(const int32_t * cpu, const int32_t * memory, const int32_t * slots, const int32_t * pool,
+                             unsigned n, int32_t want_cpu, int32_t need, int32_t pool_mask, unsigned * out, unsigned max_out) {
+    const __m256i vcpu = _mm256_set1_epi32(want_cpu);
+    const __m256i vneed = _mm256_set1_epi32(need - 1);
+    const __m256i vneg = _mm256_set1_epi32(-1);
+    const __m256i vpool = _mm256_set1_epi32(pool_mask);
+    const __m256i zero = _mm256_setzero_si256();
+
+    unsigned count = 0;
+    unsigned i = 0;
+    for (; i + 8 <= n && count < max_out; i += 8) {
+        __m256i ok = _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)(cpu + i)), vcpu);
+        ok = _mm256_and_si256(ok, _mm256_cmpgt_epi32(_mm256_loadu_si256((const __m256i *)(memory + i)), vneed));
+        ok = _mm256_and_si256(ok, _mm256_cmpgt_epi32(_mm256_loadu_si256((const __m256i *)(slots + i)), vneg));
+        __m256i outside = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_loadu_si256((const __m256i *)(pool + i)), vpool), zero);
+        ok = _mm256_andnot_si256(outside, ok);
+        count = emitRows(_mm256_movemask_ps(_mm256_castsi256_ps(ok)), i, out, count, max_out);
+    }
+    if (i < n && count < max_out) {
+        unsigned tail = feasibleSSE2(cpu + i, memory + i, slots + i, pool + i, n - i, want_cpu, need, pool_mask, out + count, max_out - count);
+        for (unsigned t = 0; t < tail; t++) {
+            out[count + t] += i;
+        }
+        count += tail;
+    }
+    return count;
+}
+#endif
+
+static FeasibleKernel_t pickKernel() {
+#ifdef CLUSTER_TABLE_X86
+    if (__builtin_cpu_supports("avx2")) {
+        return feasibleAVX2;
+    }
+    return feasibleSSE2;
+#else
+    return feasibleScalar;
+#endif
+}
+
+static const FeasibleKernel_t feasible_kernel = pickKernel();
+
+unsigned ClusterTable::slotBucket(int32_t free_slots) {
+    return (unsigned)min(max(free_slots + 1, 0), (int32_t)SLOT_BUCKETS - 1);
+}
+
+void ClusterTable::Init(const vector<MachineId_t> & order, const vector<float> & scores, const vector<unsigned> & classOfRow) {
+    unsigned n = order.size();
+    cpu.assign(n, -1);
+    free_memory.assign(n, 0);
+    free_slots.assign(n, -1);
+    pool.assign(n, 1);
+    s_state.assign(n, S0);
+    p_state.assign(n, P0);
+    efficiency.assign(n, 0);
+    machine = order;
+    row.assign(n, 0);
+    for (unsigned r = 0; r < n; r++) {
+        row[order[r]] = r;
+        efficiency[r] = scores[r];
+    }
+
+    // every row starts at S0 with no slot free (see free_slots above)
+    row_class = classOfRow;
+    classes.clear();
+    for (unsigned r = 0; r < n; r++) {
+        if (r == 0 || classOfRow[r] != classOfRow[r - 1]) {
+            ClassRows_t rows = {r, r, -1, {}, {}};
+            classes.push_back(rows);
+        }
+        row_class[r] = classes.size() - 1;
+        ClassRows_t & rows = classes.back();
+        rows.end = r + 1;
+        rows.in_state[S0]++;
+        rows.free_slots[slotBucket(-1)]++;
+    }
+}
+
+unsigned ClusterTable::WithSlots(unsigned cls, unsigned slots) const {
+    unsigned count = 0;
+    for (unsigned b = min(slots, SLOT_BUCKETS - 1); b < SLOT_BUCKETS; b++) {
+        count += classes[cls].free_slots[b];
+    }
+    return count;
+}
+
+void ClusterTable::Update(const MachineInfo_t & machineInfo, unsigned reserved_memory, unsigned reserved_vms, unsigned capacity, bool long_pool) {
+    unsigned r = row[machineInfo.machine_id];
+    cpu[r] = machineInfo.cpu;
+    free_memory[r] = (int32_t)machineInfo.memory_size - (int32_t)machineInfo.memory_used - (int32_t)reserved_memory;
+    // canHost lets a machine take VMs until it has more than capacity. tasks
+    // sharing a VM each count as one
+    int32_t vms = (int32_t)max(machineInfo.active_vms, machineInfo.active_tasks);
+    int32_t slots = (int32_t)capacity - vms - (int32_t)reserved_vms;
+    pool[r] = long_pool ? 2 : 1;
+    p_state[r] = machineInfo.p_state;
+
+    ClassRows_t & rows = classes[row_class[r]];
+    rows.cpu = machineInfo.cpu;
+    rows.free_slots[slotBucket(free_slots[r])]--;
+    rows.free_slots[slotBucket(slots)]++;
+    rows.in_state[s_state[r]]--;
+    rows.in_state[machineInfo.s_state]++;
+    free_slots[r] = slots;
+    s_state[r] = machineInfo.s_state;
+}
+
+void ClusterTable::FillClass(unsigned cls, const vector<MachineInfo_t> & machines, const vector<unsigned> & capacity) {
+    ClassRows_t & rows = classes[cls];
+    fill(begin(rows.in_state), end(rows.in_state), 0);
+    fill(begin(rows.free_slots), end(rows.free_slots), 0);
+    for (unsigned r = rows.begin; r < rows.end; r++) {
+        const MachineInfo_t & machineInfo = machines[machine[r]];
+        int32_t vms = (int32_t)max(machineInfo.active_vms, machineInfo.active_tasks);
+        int32_t slots = (int32_t)capacity[machine[r]] - vms;
+        cpu[r] = machineInfo.cpu;
+        free_memory[r] = (int32_t)machineInfo.memory_size - (int32_t)machineInfo.memory_used;
+        free_slots[r] = slots;
+        pool[r] = 1;
+        s_state[r] = machineInfo.s_state;
+        p_state[r] = machineInfo.p_state;
+        rows.cpu = machineInfo.cpu;
+        rows.in_state[machineInfo.s_state]++;
+        rows.free_slots[slotBucket(slots)]++;
+    }
+}
+
+unsigned ClusterTable::Feasible(CPUType_t want_cpu, unsigned memory, Pool_t want_pool, MachineId_t * out, unsigned max_out) const {
+    int32_t pool_mask = want_pool == ANY_POOL ? 3 : (want_pool == LONG_POOL ? 2 : 1);
+    // classes of another CPU type, or with no slot free anywhere, are skipped
+    // whole. the kernels write rows, which are mapped to machine ids in place
+    unsigned count = 0;
+    for (unsigned cls = 0; cls < classes.size() && count < max_out; cls++) {
+        const ClassRows_t & rows = classes[cls];
+        if (rows.cpu != (int32_t)want_cpu || rows.free_slots[0] == rows.end - rows.begin) {
+            continue;
+        }
+        unsigned b = rows.begin;
+        unsigned found = feasible_kernel(cpu.data() + b, free_memory.data() + b, free_slots.data() + b, pool.data() + b, rows.end - b,
+                                         want_cpu, (int32_t)memory, pool_mask, out + count, max_out - count);
+        for (unsigned i = count; i < count + found; i++) {
+            out[i] = machine[b + out[i]];
+        }
+        count += found;
+    }
+    return count;
+}
@@ -0,0 +1,86 @@
+//
+//  ClusterTable.hpp
+//  CloudSim
+//
+//  Structure-of-arrays copy of the per-machine fields placement looks at,
+//  kept in the scheduler's efficiency order and refreshed on events, so a
+//  feasibility sweep reads a few flat arrays instead of calling
+//  Machine_GetInfo (and copying its vectors) for every machine.
+//
+
+#ifndef ClusterTable_hpp
+#define ClusterTable_hpp
+
+#include <cstdint>
+#include <vector>
+
+#include "Interfaces.h"
+
+typedef enum {
+    ANY_POOL,
+    SHORT_POOL,                 // machines for short tasks, free to drain and sleep
+    LONG_POOL                   // machines designated for long-lived tasks
+} Pool_t;
+
+class ClusterTable {
+public:
+    ClusterTable()              {}
+    // rows are laid out in the given order, which is also the order
+    // Feasible reports machines in. classes gives each row's machine class;
+    // a class's rows have to be contiguous
+    void Init(const vector<MachineId_t> & order, const vector<float> & efficiency, const vector<unsigned> & classes);
+    // reserved_memory/reserved_vms are held for tasks not placed yet. a
+    // machine has a VM slot free while it hosts no more than capacity VMs
+    void Update(const MachineInfo_t & machineInfo, unsigned reserved_memory, unsigned reserved_vms, unsigned capacity, bool long_pool);
+    // every row of a class at once, from machines and capacity (both by
+    // machine id), as Update would with nothing reserved and no long pool.
+    // classes own disjoint rows, so different classes can be filled from
+    // different threads at once
+    void FillClass(unsigned cls, const vector<MachineInfo_t> & machines, const vector<unsigned> & capacity);
+
+    // collects up to max_out machines, in row order, with the CPU type, at
+    // least memory free and a VM slot left in the pool. returns how many
+    unsigned Feasible(CPUType_t cpu, unsigned memory, Pool_t pool, MachineId_t * out, unsigned max_out) const;
+
+    MachineState_t SState(MachineId_t machine) const   { return MachineState_t(s_state[row[machine]]); }
+    CPUPerformance_t PState(MachineId_t machine) const { return CPUPerformance_t(p_state[row[machine]]); }
+    float Efficiency(MachineId_t machine) const        { return efficiency[row[machine]]; }
+
+    // per-class aggregates, kept up to date by Update. a class is the row
+    // range [ClassBegin, ClassEnd)
+    unsigned Classes() const                           { return classes.size(); }
+    unsigned ClassBegin(unsigned cls) const            { return classes[cls].begin; }
+    unsigned ClassEnd(unsigned cls) const              { return classes[cls].end; }
+    unsigned ClassOf(unsigned rank) const              { return row_class[rank]; }
+    CPUType_t ClassCPU(unsigned cls) const             { return CPUType_t(classes[cls].cpu); }
+    unsigned InState(unsigned cls, MachineState_t state) const { return classes[cls].in_state[state]; }
+    // machines in the class with at least slots VM slots free
+    unsigned WithSlots(unsigned cls, unsigned slots) const;
+
+private:
+    // int32 columns so the kernels compare them 8 (AVX2) or 4 (SSE2) at a time
+    vector<int32_t> cpu;
+    vector<int32_t> free_memory;        // can go negative while overcommitted
+    vector<int32_t> free_slots;         // VMs that can still be attached, minus one
+    vector<int32_t> pool;               // 1 short, 2 long, so a pool is a bit mask
+    vector<int32_t> s_state;
+    vector<int32_t> p_state;
+    vector<float> efficiency;
+
+    vector<unsigned> row;               // machine id -> row
+    vector<MachineId_t> machine;        // row -> machine id
+
+    // free slot histogram buckets: none, 1, 2, ... SLOT_BUCKETS-1 or more
+    static const unsigned SLOT_BUCKETS = 8;
+    typedef struct {
+        unsigned begin, end;            // rows
+        int32_t cpu;
+        unsigned in_state[S_STATES];
+        unsigned free_slots[SLOT_BUCKETS];
+    } ClassRows_t;
+    vector<ClassRows_t> classes;
+    vector<unsigned> row_class;         // row -> class
+    static unsigned slotBucket(int32_t free_slots);
+};
+
+#endif /* ClusterTable_hpp */
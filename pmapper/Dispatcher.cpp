@@ -0,0 +1,123 @@
+//
+//  Dispatcher.cpp
+//  CloudSim
+//
+
+#include "Dispatcher.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <thread>
+
+void parallelFor(unsigned count, unsigned workers, const function<void(unsigned)> & body) {
+    workers = max(1u, min(workers, count));
+    if (workers == 1) {
+        for (unsigned i = 0; i < count; i++) {
+            body(i);
+        }
+        return;
+    }
+    vector<thread> threads;
+    for (unsigned w = 0; w < workers; w++) {
+        threads.emplace_back([&, w] {
+            for (unsigned i = w; i < count; i += workers) {
+                body(i);
+            }
+        });
+    }
+    for (thread & t : threads) {
+        t.join();
+    }
+}
+
+// first fit within the shard, in preference order
+bool ShardedDispatcher::place(Shard_t & shard, const BatchTask_t & task, Assignment_t & assignment) {
+    for (ShardMachine_t & machine : shard.machines) {
+        if (machine.free_slots > 0 && machine.free_memory >= task.memory) {
+            machine.free_slots--;
+            machine.free_memory -= task.memory;
+            assignment.machine = machine.machine;
+            assignment.placed = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+vector<Assignment_t> ShardedDispatcher::Plan(const vector<ShardMachine_t> & machines, const vector<BatchTask_t> & tasks, unsigned shard_size, unsigned workers) {
+    vector<Assignment_t> assignments(tasks.size());
+    for (unsigned i = 0; i < tasks.size(); i++) {
+        assignments[i] = {tasks[i].task, 0, false};
+    }
+
+    // shards by CPU type, then consecutive runs of shard_size machines, so
+    // each CPU type's first shard holds its most preferred machines
+    vector<Shard_t> shards;
+    map<CPUType_t, vector<unsigned>> byCPU;
+    for (const ShardMachine_t & machine : machines) {
+        vector<unsigned> & group = byCPU[machine.cpu];
+        if (group.empty() || shards[group.back()].machines.size() >= shard_size) {
+            group.push_back(shards.size());
+            shards.push_back({machine.cpu, {}, {}, {}});
+        }
+        shards[group.back()].machines.push_back(machine);
+    }
+
+    // hand out tasks in batch order, filling each shard up to its free VM
+    // slots before moving on to the next, the way a serial first fit would
+    map<CPUType_t, pair<unsigned, int32_t>> cursor;     // shard in group, slots handed out
+    for (unsigned i = 0; i < tasks.size(); i++) {
+        auto group = byCPU.find(tasks[i].cpu);
+        if (group == byCPU.end()) {
+            continue;       // nothing awake of this type
+        }
+        pair<unsigned, int32_t> & at = cursor[tasks[i].cpu];
+        while (at.first + 1 < group->second.size()) {
+            int32_t slots = 0;
+            for (const ShardMachine_t & machine : shards[group->second[at.first]].machines) {
+                slots += max(0, machine.free_slots);
+            }
+            if (at.second < slots) {
+                break;
+            }
+            at.first++;
+            at.second = 0;
+        }
+        shards[group->second[at.first]].queue.push_back(i);
+        at.second++;
+    }
+
+    // each shard works through its own queue
+    parallelFor(shards.size(), workers, [&](unsigned s) {
+        Shard_t & shard = shards[s];
+        for (unsigned i : shard.queue) {
+            if (!place(shard, tasks[i], assignments[i])) {
+                shard.leftover.push_back(i);
+            }
+        }
+    });
+
+    // shards with room left take what their CPU type's other shards could
+    // not place, highest priority first. CPU types share nothing, so they
+    // go in parallel
+    vector<vector<unsigned>> groups;
+    for (auto & group : byCPU) {
+        groups.push_back(group.second);
+    }
+    parallelFor(groups.size(), workers, [&](unsigned g) {
+        vector<unsigned> leftover;
+        for (unsigned s : groups[g]) {
+            leftover.insert(leftover.end(), shards[s].leftover.begin(), shards[s].leftover.end());
+        }
+        sort(leftover.begin(), leftover.end());
+        for (unsigned i : leftover) {
+            for (unsigned s : groups[g]) {
+                if (place(shards[s], tasks[i], assignments[i])) {
+                    break;
+                }
+            }
+        }
+    });
+    return assignments;
+}
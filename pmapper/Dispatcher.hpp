@@ -0,0 +1,61 @@
+//
+//  Dispatcher.hpp
+//  CloudSim
+//
+//  Sharded batch placement for arrival bursts. Machines are split into
+//  shards by CPU type and then by index range; each shard first-fits its
+//  own slice of the batch on a worker thread, and shards with room left
+//  then take over what the others could not place. The result is a plan
+//  only: the scheduler issues the VM calls itself, in batch order.
+//
+
+#ifndef Dispatcher_hpp
+#define Dispatcher_hpp
+
+#include <functional>
+#include <vector>
+
+#include "Interfaces.h"
+
+// runs body(0..count-1) on up to workers threads. items are striped over the
+// threads statically, so which thread runs what never changes the result
+void parallelFor(unsigned count, unsigned workers, const function<void(unsigned)> & body);
+
+typedef struct {
+    TaskId_t task;
+    CPUType_t cpu;
+    int32_t memory;                 // including the VM's overhead
+} BatchTask_t;
+
+typedef struct {
+    MachineId_t machine;
+    CPUType_t cpu;
+    int32_t free_memory;
+    int32_t free_slots;             // VMs it can still take
+} ShardMachine_t;
+
+typedef struct {
+    TaskId_t task;
+    MachineId_t machine;
+    bool placed;
+} Assignment_t;
+
+class ShardedDispatcher {
+public:
+    ShardedDispatcher()         {}
+    // machines in preference order. returns one assignment per task, in
+    // batch order. the plan depends only on the inputs, never on timing
+    vector<Assignment_t> Plan(const vector<ShardMachine_t> & machines, const vector<BatchTask_t> & tasks, unsigned shard_size, unsigned workers);
+
+private:
+    typedef struct {
+        CPUType_t cpu;
+        vector<ShardMachine_t> machines;
+        vector<unsigned> queue;     // indices into the batch
+        vector<unsigned> leftover;
+    } Shard_t;
+
+    static bool place(Shard_t & shard, const BatchTask_t & task, Assignment_t & assignment);
+};
+
+#endif /* Dispatcher_hpp */
@@ -0,0 +1,168 @@
+//
+//  EnergyModel.cpp
+//  CloudSim
+//
+
+#include "EnergyModel.hpp"
+
+#include <algorithm>
+
+// Machine_GetInfo leaves s_states empty in this simulator build. Until a
+// state has been measured, its baseline is estimated as a fraction of the
+// S0 baseline, following the ladder the true_tests machine classes use
+static const double DEFAULT_STATE_FRACTION[S_STATES] = {1.0, 0.83, 0.83, 0.67, 0.33, 0.08, 0.0};
+
+// time to get back to S0 from each state, as observed in the simulator for
+// S0i1..S3 (S4 and S5 are extrapolated)
+static const Time_t WAKE_LATENCY[S_STATES] = {0, 60000, 300000, 600000, 1200000, 2400000, 4800000};
+
+static double joules(double watts, Time_t duration) {
+    return watts * (double)duration / 1000000.0;
+}
+
+// C-state the idle cores sit in for each S-state (see MachineState_t)
+static CPUState_t idleCoreState(MachineState_t state) {
+    if (state <= S0i1) {
+        return C1;
+    } else if (state == S1) {
+        return C2;
+    }
+    return C4;
+}
+
+void EnergyModel::Add(const MachineInfo_t & machineInfo) {
+    MachineModel_t & model = models[machineInfo.machine_id];
+    model.num_cpus = machineInfo.num_cpus;
+    model.performance = machineInfo.performance;
+    model.c_states = machineInfo.c_states;
+    model.p_states = machineInfo.p_states;
+
+    double baseline = machineInfo.num_cpus * machineInfo.p_states[P0];
+    for (unsigned s = 0; s < S_STATES; s++) {
+        double cores = (double)machineInfo.num_cpus * machineInfo.c_states[idleCoreState(MachineState_t(s))];
+        if (machineInfo.s_states.size() == S_STATES) {
+            model.state_power[s] = machineInfo.s_states[s] + cores;
+        } else {
+            model.state_power[s] = baseline * DEFAULT_STATE_FRACTION[s] + cores;
+        }
+        model.measured[s] = false;
+        model.wake_latency[s] = WAKE_LATENCY[s];
+    }
+    if (model.state_power[S5] > 0 && machineInfo.s_states.size() != S_STATES) {
+        model.state_power[S5] = 0;      // powered off is powered off
+    }
+
+    model.last_energy = machineInfo.energy_consumed;
+    model.last_time = 0;
+    model.last_state = machineInfo.s_state;
+    model.last_tasks = machineInfo.active_tasks;
+}
+
+// calibrates state power from Machine_GetEnergy. a window only counts if the
+// machine sat idle in the same state at both ends; a task that came and went
+// in between only inflates the reading, so keep the smallest one seen
+void EnergyModel::Observe(const MachineInfo_t & machineInfo, Time_t now) {
+    MachineModel_t & model = models[machineInfo.machine_id];
+    if (now > model.last_time && model.last_state == machineInfo.s_state && model.last_tasks == 0 && machineInfo.active_tasks == 0) {
+        double power = (double)(machineInfo.energy_consumed - model.last_energy) / (double)(now - model.last_time);
+        MachineState_t state = machineInfo.s_state;
+        if (!model.measured[state] || power < model.state_power[state]) {
+            model.state_power[state] = power;
+            model.measured[state] = true;
+        }
+    }
+    model.last_energy = machineInfo.energy_consumed;
+    model.last_time = now;
+    model.last_state = machineInfo.s_state;
+    model.last_tasks = machineInfo.active_tasks;
+}
+
+double EnergyModel::StatePower(MachineId_t machine, MachineState_t state) const {
+    return models[machine].state_power[state];
+}
+
+double EnergyModel::CorePower(MachineId_t machine, CPUPerformance_t p_state) const {
+    const MachineModel_t & model = models[machine];
+    return max(0.0, (double)model.p_states[p_state] - (double)model.c_states[C1]);
+}
+
+double EnergyModel::Power(const MachineInfo_t & machineInfo) const {
+    MachineId_t machine = machineInfo.machine_id;
+    double watts = StatePower(machine, machineInfo.s_state);
+    if (machineInfo.s_state == S0) {
+        watts += min(machineInfo.active_tasks, models[machine].num_cpus) * CorePower(machine, machineInfo.p_state);
+    }
+    return watts;
+}
+
+// MIPS is millions of instructions per second == instructions per us
+Time_t EnergyModel::Runtime(MachineId_t machine, TaskId_t task_id, CPUPerformance_t p_state) const {
+    uint64_t instructions = GetTaskInfo(task_id).remaining_instructions;
+    return instructions / max(models[machine].performance[p_state], 1u);
+}
+
+Time_t EnergyModel::WakeLatency(MachineId_t machine, MachineState_t from) const {
+    return models[machine].wake_latency[from];
+}
+
+void EnergyModel::SetWakeLatency(MachineId_t machine, MachineState_t from, Time_t latency) {
+    models[machine].wake_latency[from] = latency;
+}
+
+// the task's own core energy, plus the S0 baseline for however long it keeps
+// the machine awake past its current drain point. the first task on an idle
+// machine therefore carries the whole baseline
+double EnergyModel::PlaceEnergy(MachineId_t machine, TaskId_t task_id, CPUPerformance_t p_state, unsigned active_tasks, Time_t drain, Time_t now, Time_t horizon) const {
+    const MachineModel_t & model = models[machine];
+
+    // once there are more tasks than cores, tasks time-share and stretch out
+    double stretch = max(1.0, (double)(active_tasks + 1) / (double)model.num_cpus);
+    Time_t runtime = (Time_t)(Runtime(machine, task_id, p_state) * stretch);
+    drain = max(drain, now);
+
+    Time_t extraAwake = min(max(now + runtime, drain) - drain, horizon);
+    Time_t busy = min((Time_t)(runtime / stretch), horizon);
+    return joules(StatePower(machine, S0), extraAwake) + joules(CorePower(machine, p_state), busy);
+}
+
+// the machine is assumed to draw S0 power for the whole transition
+double EnergyModel::WakeEnergy(MachineId_t machine, MachineState_t from) const {
+    return joules(StatePower(machine, S0), WakeLatency(machine, from));
+}
+
+double EnergyModel::IdleEnergy(MachineId_t machine, MachineState_t state, Time_t duration) const {
+    return joules(StatePower(machine, state), duration);
+}
+
+Time_t EnergyModel::BreakEven(MachineId_t machine, MachineState_t from, MachineState_t to) const {
+    double saved = StatePower(machine, from) - StatePower(machine, to);
+    if (saved <= 0) {
+        return UINT64_MAX;
+    }
+    double extraWake = max(0.0, WakeEnergy(machine, to) - WakeEnergy(machine, from));
+    return (Time_t)(extraWake / saved * 1000000.0);
+}
+
+CPUPerformance_t EnergyModel::CheapestPState(MachineId_t machine, uint64_t instructions, Time_t budget) const {
+    const MachineModel_t & model = models[machine];
+    CPUPerformance_t best = P0;
+    double bestEnergy = 0;
+    for (unsigned p = 0; p < model.p_states.size(); p++) {
+        Time_t runtime = instructions / max(model.performance[p], 1u);
+        if (runtime > budget) {
+            break;      // P-states only get slower from here
+        }
+        double energy = joules(CorePower(machine, CPUPerformance_t(p)), runtime);
+        if (p == 0 || energy < bestEnergy) {
+            best = CPUPerformance_t(p);
+            bestEnergy = energy;
+        }
+    }
+    return best;
+}
+
+double EnergyModel::Efficiency(MachineId_t machine) const {
+    const MachineModel_t & model = models[machine];
+    double watts = CorePower(machine, P0) + StatePower(machine, S0) / model.num_cpus;
+    return (double)model.performance[P0] / watts;
+}
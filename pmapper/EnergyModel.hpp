@@ -0,0 +1,71 @@
+//
+//  EnergyModel.hpp
+//  CloudSim
+//
+//  Predicts the marginal energy of scheduler actions (placing a task, waking
+//  a machine, leaving it idle) from each machine's power tables.
+//
+
+#ifndef EnergyModel_hpp
+#define EnergyModel_hpp
+
+#include <vector>
+
+#include "Interfaces.h"
+
+class EnergyModel {
+public:
+    EnergyModel()               {}
+    // room for machines 0..num_machines-1, each then modelled by Add. Add
+    // only touches its own machine, so different machines can be added from
+    // different threads at once
+    void Init(unsigned num_machines)                { models.resize(num_machines); }
+    void Add(const MachineInfo_t & machineInfo);
+    void Observe(const MachineInfo_t & machineInfo, Time_t now);
+
+    // power draw (W) of the whole machine idling in a given S-state
+    double StatePower(MachineId_t machine, MachineState_t state) const;
+    // extra power (W) of one core running at p_state over an idle core
+    double CorePower(MachineId_t machine, CPUPerformance_t p_state) const;
+    // what the machine draws (W) right now: its S-state baseline, plus a
+    // busy core at its P-state for each task up to the core count
+    double Power(const MachineInfo_t & machineInfo) const;
+    Time_t Runtime(MachineId_t machine, TaskId_t task_id, CPUPerformance_t p_state) const;
+    // time to get back to S0, as measured for the machine's class once it
+    // has been seen (see SetWakeLatency), or the simulator's usual figure
+    Time_t WakeLatency(MachineId_t machine, MachineState_t from) const;
+    void SetWakeLatency(MachineId_t machine, MachineState_t from, Time_t latency);
+
+    // marginal energy (J) of each action. time terms are cut off at horizon
+    double PlaceEnergy(MachineId_t machine, TaskId_t task_id, CPUPerformance_t p_state, unsigned active_tasks, Time_t drain, Time_t now, Time_t horizon) const;
+    double WakeEnergy(MachineId_t machine, MachineState_t from) const;
+    double IdleEnergy(MachineId_t machine, MachineState_t state, Time_t duration) const;
+
+    // how long a machine has to stay idle before dropping from one S-state
+    // to a deeper one saves more than waking back up costs
+    Time_t BreakEven(MachineId_t machine, MachineState_t from, MachineState_t to) const;
+    // lowest-energy P-state that still runs the instructions within budget
+    CPUPerformance_t CheapestPState(MachineId_t machine, uint64_t instructions, Time_t budget) const;
+    // machine score used for the efficiency ordering, MIPS per watt of a
+    // fully loaded machine including each core's share of the baseline
+    double Efficiency(MachineId_t machine) const;
+
+private:
+    typedef struct {
+        unsigned num_cpus;
+        vector<unsigned> performance;
+        vector<unsigned> c_states;
+        vector<unsigned> p_states;
+        double state_power[S_STATES];
+        bool measured[S_STATES];
+        Time_t wake_latency[S_STATES];
+        uint64_t last_energy;
+        Time_t last_time;
+        MachineState_t last_state;
+        unsigned last_tasks;
+    } MachineModel_t;
+
+    vector<MachineModel_t> models;      // indexed by machine id
+};
+
+#endif /* EnergyModel_hpp */
@@ -0,0 +1,78 @@
+//
+//  MachineClass.cpp
+//  CloudSim
+//
+
+#include "MachineClass.hpp"
+
+static void appendTable(vector<unsigned> & key, const vector<unsigned> & table) {
+    key.push_back(table.size());
+    key.insert(key.end(), table.begin(), table.end());
+}
+
+void MachineClasses::Add(const MachineInfo_t & machineInfo) {
+    vector<unsigned> key = {(unsigned)machineInfo.cpu, machineInfo.num_cpus, machineInfo.memory_size, machineInfo.gpus};
+    appendTable(key, machineInfo.s_states);
+    appendTable(key, machineInfo.p_states);
+    appendTable(key, machineInfo.c_states);
+    appendTable(key, machineInfo.performance);
+
+    auto found = byKey.find(key);
+    unsigned cls;
+    if (found == byKey.end()) {
+        cls = members.size();
+        byKey.emplace(move(key), cls);
+        members.emplace_back();
+    } else {
+        cls = found->second;
+    }
+    if (classOf.size() <= machineInfo.machine_id) {
+        classOf.resize(machineInfo.machine_id + 1, 0);
+    }
+    classOf[machineInfo.machine_id] = cls;
+    members[cls].push_back(machineInfo.machine_id);
+}
+
+// FNV-1a over the spec, without building a key
+static uint64_t specHash(const MachineInfo_t & machineInfo) {
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](unsigned value) {
+        hash = (hash ^ value) * 1099511628211ull;
+    };
+    mix(machineInfo.cpu);
+    mix(machineInfo.num_cpus);
+    mix(machineInfo.memory_size);
+    mix(machineInfo.gpus);
+    for (const vector<unsigned> * table : {&machineInfo.s_states, &machineInfo.p_states, &machineInfo.c_states, &machineInfo.performance}) {
+        mix(table->size());
+        for (unsigned value : *table) {
+            mix(value);
+        }
+    }
+    return hash;
+}
+
+static bool sameSpec(const MachineInfo_t & a, const MachineInfo_t & b) {
+    return a.cpu == b.cpu && a.num_cpus == b.num_cpus && a.memory_size == b.memory_size && a.gpus == b.gpus &&
+           a.s_states == b.s_states && a.p_states == b.p_states && a.c_states == b.c_states && a.performance == b.performance;
+}
+
+void MachineClasses::AddAll(const vector<MachineInfo_t> & machines) {
+    // hash -> the first machine seen with it, in machines
+    unordered_map<uint64_t, unsigned> first;
+    classOf.reserve(classOf.size() + machines.size());
+    for (unsigned i = 0; i < machines.size(); i++) {
+        const MachineInfo_t & machineInfo = machines[i];
+        auto found = first.emplace(specHash(machineInfo), i);
+        if (found.second || !sameSpec(machineInfo, machines[found.first->second])) {
+            Add(machineInfo);           // a new spec, or a hash collision
+            continue;
+        }
+        unsigned cls = classOf[machines[found.first->second].machine_id];
+        if (classOf.size() <= machineInfo.machine_id) {
+            classOf.resize(machineInfo.machine_id + 1, 0);
+        }
+        classOf[machineInfo.machine_id] = cls;
+        members[cls].push_back(machineInfo.machine_id);
+    }
+}
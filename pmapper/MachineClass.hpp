@@ -0,0 +1,40 @@
+//
+//  MachineClass.hpp
+//  CloudSim
+//
+//  Groups machines with identical specs (CPU type, cores, memory, GPU and
+//  the S/P/C-state and performance tables) into classes. Workloads describe
+//  a cluster as a handful of machine classes, so anything that only depends
+//  on the spec can be worked out once per class instead of once per machine.
+//
+
+#ifndef MachineClass_hpp
+#define MachineClass_hpp
+
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "Interfaces.h"
+
+class MachineClasses {
+public:
+    MachineClasses()            {}
+    // classes are numbered in order of their first machine
+    void Add(const MachineInfo_t & machineInfo);
+    // the whole cluster at once. a machine whose spec hashes like one seen
+    // before, and matches it, joins that machine's class without a key being
+    // built or looked up
+    void AddAll(const vector<MachineInfo_t> & machines);
+
+    unsigned Count() const                                  { return members.size(); }
+    unsigned Of(MachineId_t machine) const                  { return classOf[machine]; }
+    const vector<MachineId_t> & Members(unsigned cls) const { return members[cls]; }
+
+private:
+    map<vector<unsigned>, unsigned> byKey;
+    vector<unsigned> classOf;                   // indexed by machine id
+    vector<vector<MachineId_t>> members;        // in order added
+};
+
+#endif /* MachineClass_hpp */
@@ -0,0 +1,73 @@
+//
+//  MigrationManager.cpp
+//  CloudSim
+//
+
+#include "MigrationManager.hpp"
+
+void MigrationManager::Init(unsigned num_machines, unsigned max_in_flight, unsigned per_source, unsigned per_destination,
+                            Time_t latency, double bandwidth) {
+    this->max_in_flight = max_in_flight;
+    this->per_source = per_source;
+    this->per_destination = per_destination;
+    this->latency = latency;
+    this->bandwidth = bandwidth;
+    outgoing.assign(num_machines, 0);
+    incoming.assign(num_machines, 0);
+    incomingMemory.assign(num_machines, 0);
+}
+
+Time_t MigrationManager::Duration(unsigned memory) const {
+    if (bandwidth <= 0) {
+        return latency;
+    }
+    return latency + (Time_t)((double)memory / bandwidth * 1000000.0);
+}
+
+double MigrationManager::Cost(const EnergyModel & model, MachineId_t source, MachineId_t destination, unsigned memory) const {
+    double watts = model.StatePower(source, S0) + model.StatePower(destination, S0);
+    return watts * (double)Duration(memory) / 1000000.0;
+}
+
+bool MigrationManager::CanStart(MachineId_t source, MachineId_t destination, unsigned planned_out, unsigned planned_in) const {
+    return inFlight.size() + planned_out < max_in_flight && outgoing[source] + planned_out < per_source &&
+           incoming[destination] + planned_in < per_destination;
+}
+
+void MigrationManager::Start(VMId_t vm, MachineId_t source, MachineId_t destination, unsigned memory, Time_t now) {
+    inFlight[vm] = {vm, source, destination, memory, now, Duration(memory)};
+    outgoing[source]++;
+    incoming[destination]++;
+    incomingMemory[destination] += memory;
+}
+
+bool MigrationManager::Finish(VMId_t vm, Time_t now, Migration_t & done) {
+    auto it = inFlight.find(vm);
+    if (it == inFlight.end()) {
+        return false;
+    }
+    done = it->second;
+    inFlight.erase(it);
+    outgoing[done.source]--;
+    incoming[done.destination]--;
+    incomingMemory[done.destination] -= done.memory;
+
+    Time_t took = now - done.start;
+    completed++;
+    totalLatency += took;
+    maxLatency = max(maxLatency, took);
+    totalError += ((double)took - (double)done.expected) / 1000000.0;
+    return true;
+}
+
+double MigrationManager::MeanLatency() const {
+    return completed == 0 ? 0 : (double)totalLatency / completed / 1000000.0;
+}
+
+double MigrationManager::MaxLatency() const {
+    return (double)maxLatency / 1000000.0;
+}
+
+double MigrationManager::MeanError() const {
+    return completed == 0 ? 0 : totalError / completed;
+}
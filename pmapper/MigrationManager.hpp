@@ -0,0 +1,78 @@
+//
+//  MigrationManager.hpp
+//  CloudSim
+//
+//  Book-keeping for VM migrations: what each one is expected to take and
+//  cost, which are in flight (so nothing is placed into them and their
+//  destinations stay reserved), per-machine concurrency limits, and how
+//  long they actually took.
+//
+
+#ifndef MigrationManager_hpp
+#define MigrationManager_hpp
+
+#include <unordered_map>
+#include <vector>
+
+#include "EnergyModel.hpp"
+#include "Interfaces.h"
+
+typedef struct {
+    VMId_t vm;
+    MachineId_t source;
+    MachineId_t destination;
+    unsigned memory;                // footprint reserved on the destination
+    Time_t start;
+    Time_t expected;                // predicted duration
+} Migration_t;
+
+class MigrationManager {
+public:
+    MigrationManager()          {}
+    // latency is the fixed part of a migration; bandwidth (MB/s) adds the
+    // time to copy the footprint, 0 leaves that out
+    void Init(unsigned num_machines, unsigned max_in_flight, unsigned per_source, unsigned per_destination,
+              Time_t latency, double bandwidth);
+
+    Time_t Duration(unsigned memory) const;
+    // energy (J) of the move: the source can't sleep and the destination
+    // carries the VM's stalled tasks for as long as it takes
+    double Cost(const EnergyModel & model, MachineId_t source, MachineId_t destination, unsigned memory) const;
+
+    // false once the cluster, the source or the destination is at its
+    // limit. planned_* count moves decided on but not started yet
+    bool CanStart(MachineId_t source, MachineId_t destination, unsigned planned_out = 0, unsigned planned_in = 0) const;
+    void Start(VMId_t vm, MachineId_t source, MachineId_t destination, unsigned memory, Time_t now);
+    // false if the VM was not being migrated by us
+    bool Finish(VMId_t vm, Time_t now, Migration_t & done);
+
+    bool InFlight(VMId_t vm) const                  { return inFlight.count(vm) > 0; }
+    bool Involved(MachineId_t machine) const        { return outgoing[machine] + incoming[machine] > 0; }
+    unsigned Incoming(MachineId_t machine) const    { return incoming[machine]; }
+    unsigned IncomingMemory(MachineId_t machine) const { return incomingMemory[machine]; }
+
+    // latency stats over finished migrations
+    unsigned Completed() const                      { return completed; }
+    double MeanLatency() const;                     // seconds
+    double MaxLatency() const;                      // seconds
+    double MeanError() const;                       // seconds, actual - expected
+
+private:
+    unsigned max_in_flight = 0;
+    unsigned per_source = 0;
+    unsigned per_destination = 0;
+    Time_t latency = 0;
+    double bandwidth = 0;
+
+    unordered_map<VMId_t, Migration_t> inFlight;
+    vector<unsigned> outgoing;                      // indexed by machine id
+    vector<unsigned> incoming;
+    vector<unsigned> incomingMemory;
+
+    unsigned completed = 0;
+    Time_t totalLatency = 0;
+    Time_t maxLatency = 0;
+    double totalError = 0;
+};
+
+#endif /* MigrationManager_hpp */
@@ -0,0 +1,135 @@
+//
+//  ParamSet.cpp
+//  CloudSim
+//
+
+#include "ParamSet.hpp"
+
+#include <cerrno>
+#include <cinttypes>
+#include <cstdlib>
+
+void ParamSet::Add(const string & name, bool * value)       { params[name] = {BOOL_PARAM, value}; }
+void ParamSet::Add(const string & name, int * value)        { params[name] = {INT_PARAM, value}; }
+void ParamSet::Add(const string & name, unsigned * value)   { params[name] = {UNSIGNED_PARAM, value}; }
+void ParamSet::Add(const string & name, uint64_t * value)   { params[name] = {UINT64_PARAM, value}; }
+void ParamSet::Add(const string & name, double * value)     { params[name] = {DOUBLE_PARAM, value}; }
+
+static string trim(const string & text) {
+    size_t first = text.find_first_not_of(" \t\r\n");
+    if (first == string::npos) {
+        return "";
+    }
+    size_t last = text.find_last_not_of(" \t\r\n");
+    return text.substr(first, last - first + 1);
+}
+
+// the whole value has to parse, so "10s" or "1e" are rejected
+bool ParamSet::set(const Param_t & param, const string & text) {
+    const char * begin = text.c_str();
+    char * end = nullptr;
+    errno = 0;
+    switch (param.type) {
+        case BOOL_PARAM:
+            if (text == "true" || text == "1") {
+                *(bool *)param.value = true;
+                return true;
+            }
+            if (text == "false" || text == "0") {
+                *(bool *)param.value = false;
+                return true;
+            }
+            return false;
+        case INT_PARAM: {
+            long value = strtol(begin, &end, 10);
+            if (*end != '\0' || end == begin || errno != 0 || value < INT32_MIN || value > INT32_MAX) {
+                return false;
+            }
+            *(int *)param.value = (int)value;
+            return true;
+        }
+        case UNSIGNED_PARAM: {
+            if (text[0] == '-') {
+                return false;
+            }
+            unsigned long value = strtoul(begin, &end, 10);
+            if (*end != '\0' || end == begin || errno != 0 || value > UINT32_MAX) {
+                return false;
+            }
+            *(unsigned *)param.value = (unsigned)value;
+            return true;
+        }
+        case UINT64_PARAM: {
+            if (text[0] == '-') {
+                return false;
+            }
+            unsigned long long value = strtoull(begin, &end, 10);
+            if (*end != '\0' || end == begin || errno != 0) {
+                return false;
+            }
+            *(uint64_t *)param.value = value;
+            return true;
+        }
+        case DOUBLE_PARAM: {
+            double value = strtod(begin, &end);
+            if (*end != '\0' || end == begin || errno != 0) {
+                return false;
+            }
+            *(double *)param.value = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ParamSet::Load(const string & path, string & error) {
+    FILE * in = fopen(path.c_str(), "r");
+    if (in == nullptr) {
+        error = "cannot open " + path;
+        return false;
+    }
+
+    char buffer[1024];
+    unsigned line = 0;
+    bool ok = true;
+    while (ok && fgets(buffer, sizeof(buffer), in) != nullptr) {
+        line++;
+        string text = buffer;
+        text = trim(text.substr(0, text.find('#')));
+        if (text.empty()) {
+            continue;
+        }
+        size_t equals = text.find('=');
+        if (equals == string::npos) {
+            error = path + ":" + to_string(line) + ": expected name = value";
+            ok = false;
+            break;
+        }
+        string name = trim(text.substr(0, equals));
+        string value = trim(text.substr(equals + 1));
+        auto param = params.find(name);
+        if (param == params.end()) {
+            error = path + ":" + to_string(line) + ": unknown parameter " + name;
+            ok = false;
+        } else if (!set(param->second, value)) {
+            error = path + ":" + to_string(line) + ": bad value for " + name + ": " + value;
+            ok = false;
+        }
+    }
+    fclose(in);
+    return ok;
+}
+
+void ParamSet::Write(FILE * out) const {
+    for (auto & entry : params) {
+        const Param_t & param = entry.second;
+        fprintf(out, "%s = ", entry.first.c_str());
+        switch (param.type) {
+            case BOOL_PARAM:     fprintf(out, "%s\n", *(bool *)param.value ? "true" : "false"); break;
+            case INT_PARAM:      fprintf(out, "%d\n", *(int *)param.value); break;
+            case UNSIGNED_PARAM: fprintf(out, "%u\n", *(unsigned *)param.value); break;
+            case UINT64_PARAM:   fprintf(out, "%" PRIu64 "\n", *(uint64_t *)param.value); break;
+            case DOUBLE_PARAM:   fprintf(out, "%.6g\n", *(double *)param.value); break;
+        }
+    }
+}
@@ -0,0 +1,55 @@
+//
+//  ParamSet.hpp
+//  CloudSim
+//
+//  Named scheduler knobs that can be overridden from a parameter file at
+//  startup. The file has one "name = value" per line; '#' starts a comment.
+//  Knobs are registered as pointers to the variables that hold them, so
+//  whatever is not in the file keeps its compiled-in default.
+//
+
+#ifndef ParamSet_hpp
+#define ParamSet_hpp
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <string>
+
+#include "Interfaces.h"
+
+class ParamSet {
+public:
+    ParamSet()                  {}
+    void Add(const string & name, bool * value);
+    void Add(const string & name, int * value);
+    void Add(const string & name, unsigned * value);
+    void Add(const string & name, uint64_t * value);
+    void Add(const string & name, double * value);
+
+    // false (with a message in error) on a bad line, an unknown name or a
+    // value that does not parse. values before the bad line are kept
+    bool Load(const string & path, string & error);
+
+    // every knob with its current value, in the format Load reads
+    void Write(FILE * out) const;
+
+private:
+    typedef enum {
+        BOOL_PARAM,
+        INT_PARAM,
+        UNSIGNED_PARAM,
+        UINT64_PARAM,
+        DOUBLE_PARAM
+    } ParamType_t;
+
+    typedef struct {
+        ParamType_t type;
+        void * value;
+    } Param_t;
+
+    map<string, Param_t> params;
+    bool set(const Param_t & param, const string & text);
+};
+
+#endif /* ParamSet_hpp */
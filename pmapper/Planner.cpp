@@ -0,0 +1,100 @@
+//
+//  Planner.cpp
+//  CloudSim
+//
+
+#include "Planner.hpp"
+
+static MachineState_t getNextState(MachineState_t currentState) {
+    if (currentState < S5) {
+        return static_cast<MachineState_t>(currentState + 1);
+    } else {
+        return S5;
+    }
+}
+
+void Planner::Start() {
+    lock_guard<mutex> guard(lock);
+    if (running) {
+        return;
+    }
+    running = true;
+    worker = thread(&Planner::run, this);
+}
+
+void Planner::Stop() {
+    {
+        lock_guard<mutex> guard(lock);
+        if (!running) {
+            return;
+        }
+        running = false;
+    }
+    work_ready.notify_one();
+    worker.join();
+}
+
+void Planner::Submit(ClusterSnapshot_t next) {
+    {
+        lock_guard<mutex> guard(lock);
+        snapshot = std::move(next);
+        has_snapshot = true;
+    }
+    work_ready.notify_one();
+}
+
+bool Planner::TakePlan(PowerPlan_t & out) {
+    lock_guard<mutex> guard(lock);
+    if (!has_plan) {
+        return false;
+    }
+    out = std::move(plan);
+    has_plan = false;
+    return true;
+}
+
+void Planner::run() {
+    unique_lock<mutex> guard(lock);
+    while (true) {
+        work_ready.wait(guard, [this] { return has_snapshot || !running; });
+        if (!running) {
+            return;
+        }
+        ClusterSnapshot_t work = std::move(snapshot);
+        has_snapshot = false;
+
+        guard.unlock();
+        PowerPlan_t result = PlanPowerSteps(work);
+        guard.lock();
+
+        plan = std::move(result);
+        has_plan = true;
+    }
+}
+
+PowerPlan_t Planner::PlanPowerSteps(const ClusterSnapshot_t & snapshot) {
+    PowerPlan_t result;
+    result.epoch = snapshot.epoch;
+    result.reverse_limit = snapshot.reverse_limit;
+    if (snapshot.sla_breached || !snapshot.queue_empty) {
+        return result;
+    }
+
+    // counted by rank, since the snapshot need not hold every machine
+    for (auto machine = snapshot.machines.rbegin(); machine != snapshot.machines.rend(); ++machine) {
+        int count_backwards = (int)(snapshot.num_machines - machine->rank);
+
+        // hit limit on machines allowed to be turned off
+        if (count_backwards >= snapshot.reverse_limit) {
+            break;
+        }
+
+        // one step at a time, and never while a transition is in flight or
+        // tasks are waiting for the machine to come up
+        MachineState_t nextState = min(getNextState(machine->s_state), machine->deepest);
+        if (machine->active_tasks == 0 && !machine->busy && nextState != machine->pending && nextState > machine->s_state) {
+            result.steps.push_back({machine->machine, machine->s_state, machine->pending, nextState});
+        }
+    }
+    return result;
+}
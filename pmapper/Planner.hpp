@@ -0,0 +1,82 @@
+//
+//  Planner.hpp
+//  CloudSim
+//
+//  Periodic power planning, run either inline or on a background thread.
+//  Each SchedulerCheck hands the planner an immutable snapshot of the
+//  cluster; in async mode a worker turns it into a plan while the
+//  simulator carries on, and the scheduler applies the latest finished
+//  plan on a later check after validating it against the live state.
+//
+
+#ifndef Planner_hpp
+#define Planner_hpp
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Interfaces.h"
+
+typedef struct {
+    MachineId_t machine;
+    unsigned rank;                  // position in the efficiency order
+    MachineState_t s_state;
+    MachineState_t pending;         // state the scheduler last asked for
+    unsigned active_tasks;
+    bool busy;                      // transitioning, or tasks waiting on it
+    MachineState_t deepest;         // standby tier: never stepped past this
+} MachineSnapshot_t;
+
+typedef struct {
+    uint64_t epoch;
+    vector<MachineSnapshot_t> machines;     // most efficient first, may skip parked ones
+    unsigned num_machines;          // in the whole cluster
+    bool queue_empty;
+    int reverse_limit;              // how many of the least efficient machines may step down
+    bool sla_breached;              // too many violations to save energy at all
+} ClusterSnapshot_t;
+
+typedef struct {
+    MachineId_t machine;
+    MachineState_t from;            // states the plan was made against
+    MachineState_t pending;
+    MachineState_t to;
+} PowerStep_t;
+
+typedef struct {
+    uint64_t epoch;                 // of the snapshot it was made from
+    int reverse_limit;
+    vector<PowerStep_t> steps;
+} PowerPlan_t;
+
+class Planner {
+public:
+    Planner()                   {}
+    ~Planner()                  { Stop(); }
+    void Start();
+    void Stop();
+    // replaces any snapshot the worker has not picked up yet
+    void Submit(ClusterSnapshot_t snapshot);
+    // takes the newest finished plan, if there is one not taken yet
+    bool TakePlan(PowerPlan_t & plan);
+
+    // steps idle machines, least efficient first, one S-state deeper (down
+    // to their tier's state)
+    static PowerPlan_t PlanPowerSteps(const ClusterSnapshot_t & snapshot);
+
+private:
+    void run();
+
+    thread worker;
+    mutex lock;
+    condition_variable work_ready;
+    bool running = false;
+    bool has_snapshot = false;
+    bool has_plan = false;
+    ClusterSnapshot_t snapshot;
+    PowerPlan_t plan;
+};
+
+#endif /* Planner_hpp */
@@ -6,34 +6,210 @@
 //
 
 #include "Scheduler.hpp"
+#include "EnergyModel.hpp"
+#include "ClusterTable.hpp"
+#include "Planner.hpp"
+#include "Dispatcher.hpp"
+#include "TaskReport.hpp"
+#include "Timeline.hpp"
+#include "ParamSet.hpp"
+#include "MachineClass.hpp"
+#include "MigrationManager.hpp"
+#include "StandbyPool.hpp"
+#include "CapacityPlan.hpp"
 #include <algorithm>
+#include <chrono>
+#include <cstdlib>
 #include <queue>
-static bool migrating = false;
 static unsigned active_machines = 16;
 static unsigned VM_OVERHEAD = 8;
 static unsigned tasks_done = 0; 
 static unsigned sla_violations = 0;
 static int reverse_limit = 0;
-    
-struct TaskPriorityComparator {
-    bool operator()(TaskId_t a, TaskId_t b) {
-        SLAType_t aReqSLA = RequiredSLA(a);
-        SLAType_t bReqSLA = RequiredSLA(b);
-        Time_t aTargetCompletion = GetTaskInfo(a).target_completion;
-        Time_t bTargetCompletion = GetTaskInfo(b).target_completion;
 
-        // first, we prioritize the SLA 
-        // SLA0 highest priority, SLA3 is lowest
-        if (aReqSLA != bReqSLA) {
-            return aReqSLA < bReqSLA;
-        }
+// power-down pacing: reverse_limit (how many of the least efficient machines
+// may step down) grows by REVERSE_STEP a check once POWER_DOWN_GATE percent
+// of tasks are done. waking a machine for a task takes WAKE_PENALTY off it,
+// and a machine found off with tasks on it sets it to -BROKEN_PENALTY
+static int REVERSE_STEP = 1;
+static int WAKE_PENALTY = 10;
+static int BROKEN_PENALTY = 1000;
+static double POWER_DOWN_GATE = 10;             // percent of tasks done
+// past this fraction of tasks violating their SLA, stop saving energy
+static double SLA_BREACH_FRACTION = 0.05;
+// VMs a machine may host per core
+static double VMS_PER_CORE = 1.0;
 
-        // if equal SLA, do the one that needs to be done first
-        return aTargetCompletion > bTargetCompletion;
-    }
-};
+// lookahead placement: score the first K feasible machines over a short
+// horizon instead of taking the first one that fits
+static bool lookahead_enabled = true;
+static unsigned LOOKAHEAD_K = 8;
+static Time_t LOOKAHEAD_HORIZON = 10000000;     // 10 sec
+static unsigned LOOKAHEAD_BUDGET_US = 200;      // per placement decision
+
+// per-core DVFS: run each core at the slowest P-state its tasks' deadlines
+// allow, using only this fraction of the time left before each deadline
+static bool per_core_dvfs_enabled = false;
+static double DVFS_SLACK_MARGIN = 0.8;
+
+// short/long segregation: tasks expected to run at least LONG_TASK_RUNTIME
+// are packed onto a long-lived pool of machines so the rest can drain
+static bool segregation_enabled = false;
+static Time_t LONG_TASK_RUNTIME = 3000000;      // 3 sec
+// deadline window over expected runtime, per SLA, in the generated workloads
+static const double SLA_WINDOW_FACTOR[NUM_SLAS] = {4.0, 9.0, 13.0, 13.0};
+static unsigned fastest_mips[4] = {1, 1, 1, 1};  // by CPUType_t
+
+// SLA3 deferral lane: best-effort tasks wait for spare capacity on machines
+// that are already awake, or until they have waited SLA3_MAX_DEFERRAL
+static bool sla3_deferral_enabled = true;
+static Time_t SLA3_MAX_DEFERRAL = 60000000;     // 60 sec
+
+// completion dispatch: a finished task's machine is refilled straight from
+// the queue, looking at no more than COMPLETION_SCAN queued tasks
+static bool completion_dispatch_enabled = true;
+static unsigned COMPLETION_SCAN = 16;
+
+// async planner: power stepping is planned on a worker thread from a
+// snapshot taken at each check, and applied (if still valid) a check later
+static bool async_planner_enabled = false;
+
+// parallel dispatch: once more than BURST_ARRIVALS tasks arrive within one
+// check, arrivals are held and placed in batches by the sharded dispatcher
+static bool parallel_dispatch_enabled = false;
+static unsigned BURST_ARRIVALS = 64;
+static unsigned SHARD_SIZE = 64;                // machines per shard
+static unsigned DISPATCH_WORKERS = 4;
+static unsigned arrivals_this_check = 0;
+
+// per-task outcome report, written as TASK_REPORT_PATH.csv/.json at the end
+static bool task_report_enabled = true;
+static const string TASK_REPORT_PATH = "task_report";
+
+// cluster timeline sampled every check, written to TIMELINE_PATH at the end.
+// a full buffer is downsampled (or overwritten oldest first if that is off)
+static bool timeline_enabled = true;
+static bool timeline_downsample = true;
+static unsigned TIMELINE_CAPACITY = 4096;               // samples
+static size_t TIMELINE_MAX_BYTES = 64 << 20;            // per-machine energy columns
+static const string TIMELINE_PATH = "timeline.csv";
+
+// dirty-set checks: a check only reads machines whose load or state changed
+// since the last one (or that are still settling), plus a rotating sweep of
+// SWEEP_PER_CHECK machines so nothing goes unobserved for long
+static bool dirty_checks_enabled = true;
+static unsigned SWEEP_PER_CHECK = 32;
+
+// VM packing: a task joins a VM already on its machine (same VM type and
+// SLA, never SLA0) instead of paying for a VM of its own, as long as the VM
+// has fewer than TASKS_PER_VM tasks and the task still makes its deadline
+// with the machine that much busier. a full VM takes no more, so the next
+// task splits off into a new one. VM slots are counted per task either way,
+// so packing saves memory overhead, it does not stack more tasks on a core
+static bool vm_packing_enabled = false;
+static unsigned TASKS_PER_VM = 4;
+
+// adaptive oversubscription: a machine may take more than VMS_PER_CORE
+// tasks per core, up to OVERSUB_MAX_PER_CORE, while every resident with a
+// deadline would still make it at the slowdown that load implies, with
+// oversub_margin to spare. each SLAWarning widens the margin by
+// OVERSUB_BACKOFF, and every quiet check relaxes it by OVERSUB_RELAX back
+// toward OVERSUB_MARGIN
+static bool oversub_enabled = false;
+static double OVERSUB_MAX_PER_CORE = 2.0;
+static double OVERSUB_MARGIN = 1.5;
+static double OVERSUB_BACKOFF = 1.25;
+static double OVERSUB_RELAX = 0.98;
+static double oversub_margin = 1.5;
+static unsigned warnings_this_check = 0;
+static vector<unsigned> vm_capacity;            // VM slots, by machine id
+
+// migration: each check, up to MIGRATION_CANDIDATES of the least efficient
+// awake machines are considered for draining onto more efficient ones. a
+// drain goes ahead only if every VM has a destination, every task still
+// makes its deadline after sitting out the move, and the time the source
+// then sleeps saves more than the moves cost. the simulator takes a flat
+// 30 sec per migration; MIGRATION_BANDWIDTH (MB/s) adds copy time on top
+static bool migration_enabled = false;
+static unsigned MIGRATION_CANDIDATES = 4;
+static unsigned MIGRATIONS_IN_FLIGHT = 16;
+static unsigned MIGRATIONS_PER_SOURCE = 4;
+static unsigned MIGRATIONS_PER_DESTINATION = 2;
+static Time_t MIGRATION_LATENCY = 30000000;     // 30 sec
+static double MIGRATION_BANDWIDTH = 1000;
+
+// power cap: while the estimated cluster draw is over POWER_CAP_WATTS, each
+// check steps down the P-state of the busy machines with the most deadline
+// slack (one step each, as many machines as it takes), and if that is not
+// enough holds SLA3 dispatch. below POWER_CAP_RESUME of the cap, SLA3 goes
+// out again and throttled machines step back up
+static bool power_cap_enabled = false;
+static double POWER_CAP_WATTS = 20000;
+static double POWER_CAP_RESUME = 0.9;
+static double cluster_power = 0;                // estimated draw, W
+static vector<double> machine_power;            // by machine id
+static vector<CPUPerformance_t> capped_pstate;  // by machine id, P0 if not throttled
+static unsigned throttled_machines = 0;
+static bool sla3_held = false;
+// what the cap cost: time over it, time throttled or holding SLA3, and the
+// SLA warnings in that time
+static Time_t last_check = 0;
+static Time_t time_over_cap = 0;
+static Time_t time_capped = 0;
+static unsigned warnings_capped = 0;
+static double peak_power = 0;
+
+// standby pool: rather than every idle machine sinking to S5, each machine
+// class keeps an instant tier in S0i1 and a fast tier in S1, filled with its
+// most efficient idle machines. tiers are sized from the class's demand for
+// fresh hosts so the expected wait for one stays under STANDBY_WAIT_TARGET
+// (see StandbyPool), and a short tier is topped up from parked machines.
+// wake latencies are measured either way and feed the energy model
+static bool standby_enabled = false;
+static Time_t STANDBY_WAIT_TARGET = 50000;      // 50 ms
+static const MachineState_t INSTANT_TIER = S0i1;
+static const MachineState_t FAST_TIER = S1;
+static const MachineState_t DEEP_TIER = S5;
+
+// capacity plan: PMAPPER_PLAN names a plan from capplan (see
+// capplan/CapPlan.cpp) with the slots each CPU type needs over time. with
+// one loaded, the most efficient machines of a type that cover what the
+// plan wants a wake latency plus PLAN_LEAD from now are woken early and
+// held up, and power-downs don't wait for POWER_DOWN_GATE. the plan is
+// scaled by how the tasks actually running compare with what it expected
+static Time_t PLAN_LEAD = 1000000;              // 1 sec
+static double PLAN_SMOOTHING = 0.2;
+static double PLAN_CORRECTION_MAX = 4.0;
+static double plan_correction[4] = {1, 1, 1, 1};    // by CPUType_t
+static Time_t plan_step[4] = {0, 0, 0, 0};          // start of the step in effect
+static bool plan_rising[4] = {false, false, false, false};
+static unsigned running_tasks[4] = {0, 0, 0, 0};
+
+// startup: Init reads every machine from the simulator once, then builds
+// the energy models, class ranking and placement table from that copy.
+// from INIT_PARALLEL_MIN machines up the per-machine and per-class work is
+// spread over INIT_WORKERS threads; the simulator is only called from this
+// one. each phase's time goes in a single line at the end
+static unsigned INIT_PARALLEL_MIN = 16384;
+static unsigned INIT_WORKERS = 4;
+static const unsigned INIT_BLOCK = 1024;        // machines per work item
+
+// every knob above can be overridden from the file PMAPPER_PARAMS names;
+// PMAPPER_PARAMS_DUMP names a file to write the values in effect to
+static ParamSet params;
 
 priority_queue<int, vector<int>, TaskPriorityComparator> task_queue;
+static EnergyModel energy_model;
+static ClusterTable cluster_table;
+static MachineClasses machine_classes;
+static MigrationManager migrations;
+static StandbyPool standby;
+static CapacityPlan capacity_plan;
+static Planner planner;
+static uint64_t plan_epoch = 0;
+static ShardedDispatcher dispatcher;
+static TaskReport task_report;
+static Timeline timeline;
 
 
 CPUPerformance_t mostEfficientPState(MachineId_t machine) {
@@ -54,15 +230,98 @@ CPUPerformance_t mostEfficientPState(MachineId_t machine) {
 }
 
 float scoreEfficiency(MachineId_t machine) {
-    MachineInfo_t machineInfo = Machine_GetInfo(machine);
-    CPUPerformance_t bestState = CPUPerformance_t(0);//mostEfficientPState(machine);
-    unsigned performance = machineInfo.performance[bestState];
-    unsigned powerConsumption = machineInfo.p_states[bestState];
-    return (float)(performance) / (float)(powerConsumption);
+    return energy_model.Efficiency(machine);
 }
 
-bool compareEnergyEfficiency(MachineId_t a, MachineId_t b) {
-    return scoreEfficiency(a) > scoreEfficiency(b);  //  Sort in descending order
+static void registerParams() {
+    params.Add("VM_OVERHEAD", &VM_OVERHEAD);
+    params.Add("REVERSE_STEP", &REVERSE_STEP);
+    params.Add("WAKE_PENALTY", &WAKE_PENALTY);
+    params.Add("BROKEN_PENALTY", &BROKEN_PENALTY);
+    params.Add("POWER_DOWN_GATE", &POWER_DOWN_GATE);
+    params.Add("SLA_BREACH_FRACTION", &SLA_BREACH_FRACTION);
+    params.Add("VMS_PER_CORE", &VMS_PER_CORE);
+    params.Add("lookahead_enabled", &lookahead_enabled);
+    params.Add("LOOKAHEAD_K", &LOOKAHEAD_K);
+    params.Add("LOOKAHEAD_HORIZON", &LOOKAHEAD_HORIZON);
+    params.Add("LOOKAHEAD_BUDGET_US", &LOOKAHEAD_BUDGET_US);
+    params.Add("per_core_dvfs_enabled", &per_core_dvfs_enabled);
+    params.Add("DVFS_SLACK_MARGIN", &DVFS_SLACK_MARGIN);
+    params.Add("segregation_enabled", &segregation_enabled);
+    params.Add("LONG_TASK_RUNTIME", &LONG_TASK_RUNTIME);
+    params.Add("sla3_deferral_enabled", &sla3_deferral_enabled);
+    params.Add("SLA3_MAX_DEFERRAL", &SLA3_MAX_DEFERRAL);
+    params.Add("completion_dispatch_enabled", &completion_dispatch_enabled);
+    params.Add("COMPLETION_SCAN", &COMPLETION_SCAN);
+    params.Add("async_planner_enabled", &async_planner_enabled);
+    params.Add("parallel_dispatch_enabled", &parallel_dispatch_enabled);
+    params.Add("BURST_ARRIVALS", &BURST_ARRIVALS);
+    params.Add("SHARD_SIZE", &SHARD_SIZE);
+    params.Add("DISPATCH_WORKERS", &DISPATCH_WORKERS);
+    params.Add("task_report_enabled", &task_report_enabled);
+    params.Add("timeline_enabled", &timeline_enabled);
+    params.Add("timeline_downsample", &timeline_downsample);
+    params.Add("TIMELINE_CAPACITY", &TIMELINE_CAPACITY);
+    params.Add("TIMELINE_MAX_BYTES", &TIMELINE_MAX_BYTES);
+    params.Add("dirty_checks_enabled", &dirty_checks_enabled);
+    params.Add("SWEEP_PER_CHECK", &SWEEP_PER_CHECK);
+    params.Add("vm_packing_enabled", &vm_packing_enabled);
+    params.Add("TASKS_PER_VM", &TASKS_PER_VM);
+    params.Add("oversub_enabled", &oversub_enabled);
+    params.Add("OVERSUB_MAX_PER_CORE", &OVERSUB_MAX_PER_CORE);
+    params.Add("OVERSUB_MARGIN", &OVERSUB_MARGIN);
+    params.Add("OVERSUB_BACKOFF", &OVERSUB_BACKOFF);
+    params.Add("OVERSUB_RELAX", &OVERSUB_RELAX);
+    params.Add("migration_enabled", &migration_enabled);
+    params.Add("MIGRATION_CANDIDATES", &MIGRATION_CANDIDATES);
+    params.Add("MIGRATIONS_IN_FLIGHT", &MIGRATIONS_IN_FLIGHT);
+    params.Add("MIGRATIONS_PER_SOURCE", &MIGRATIONS_PER_SOURCE);
+    params.Add("MIGRATIONS_PER_DESTINATION", &MIGRATIONS_PER_DESTINATION);
+    params.Add("MIGRATION_LATENCY", &MIGRATION_LATENCY);
+    params.Add("MIGRATION_BANDWIDTH", &MIGRATION_BANDWIDTH);
+    params.Add("power_cap_enabled", &power_cap_enabled);
+    params.Add("POWER_CAP_WATTS", &POWER_CAP_WATTS);
+    params.Add("POWER_CAP_RESUME", &POWER_CAP_RESUME);
+    params.Add("standby_enabled", &standby_enabled);
+    params.Add("STANDBY_WAIT_TARGET", &STANDBY_WAIT_TARGET);
+    params.Add("PLAN_LEAD", &PLAN_LEAD);
+    params.Add("PLAN_SMOOTHING", &PLAN_SMOOTHING);
+    params.Add("PLAN_CORRECTION_MAX", &PLAN_CORRECTION_MAX);
+    params.Add("INIT_PARALLEL_MIN", &INIT_PARALLEL_MIN);
+    params.Add("INIT_WORKERS", &INIT_WORKERS);
+}
+
+// overrides from PMAPPER_PARAMS, if set, before anything reads the knobs
+static void loadParams() {
+    registerParams();
+    const char * path = getenv("PMAPPER_PARAMS");
+    if (path != nullptr && *path != '\0') {
+        string error;
+        if (!params.Load(path, error)) {
+            ThrowException("Scheduler::Init(): ", error);
+        }
+        SimOutput("Scheduler::Init(): Parameters loaded from " + string(path), 1);
+    }
+    const char * dump = getenv("PMAPPER_PARAMS_DUMP");
+    if (dump != nullptr && *dump != '\0') {
+        FILE * out = fopen(dump, "w");
+        if (out != nullptr) {
+            params.Write(out);
+            fclose(out);
+        }
+    }
+}
+
+static void loadPlan() {
+    const char * path = getenv("PMAPPER_PLAN");
+    if (path == nullptr || *path == '\0') {
+        return;
+    }
+    string error;
+    if (!capacity_plan.Load(path, error)) {
+        ThrowException("Scheduler::Init(): ", error);
+    }
+    SimOutput("Scheduler::Init(): Capacity plan loaded from " + string(path), 1);
 }
 
 void Scheduler::Init() {
@@ -74,37 +333,855 @@ void Scheduler::Init() {
     //      Get the number of CPUs
     //      Get if there is a GPU or not
     // 
+    typedef chrono::steady_clock Clock;
+    Clock::time_point started = Clock::now(), mark = started;
+    auto lap = [&mark]() {
+        Clock::time_point now = Clock::now();
+        double ms = chrono::duration<double, milli>(now - mark).count();
+        mark = now;
+        return ms;
+    };
+
     SimOutput("Scheduler::Init(): Total number of machines is " + to_string(Machine_GetTotal()), 3);
     SimOutput("Scheduler::Init(): Initializing scheduler", 1);
+    loadParams();
+    loadPlan();
+    double paramsMs = lap();
     active_machines = Machine_GetTotal();
+    oversub_margin = OVERSUB_MARGIN;
+    unsigned workers = active_machines >= INIT_PARALLEL_MIN ? max(1u, INIT_WORKERS) : 1;
+    unsigned blocks = (active_machines + INIT_BLOCK - 1) / INIT_BLOCK;
+    auto eachMachine = [&](const function<void(unsigned)> & body) {
+        parallelFor(blocks, workers, [&](unsigned block) {
+            for (unsigned i = block * INIT_BLOCK; i < min(active_machines, (block + 1) * INIT_BLOCK); i++) {
+                body(i);
+            }
+        });
+    };
 
+    // the only pass over the simulator's machines
+    vector<MachineInfo_t> infos(active_machines);
+    for (unsigned i = 0; i < active_machines; i++) {
+        infos[i] = Machine_GetInfo(MachineId_t(i));
+    }
+    double readMs = lap();
+
+    machine_classes.AddAll(infos);
+    for (unsigned cls = 0; cls < machine_classes.Count(); cls++) {
+        const MachineInfo_t & machineInfo = infos[machine_classes.Members(cls).front()];
+        fastest_mips[machineInfo.cpu] = max(fastest_mips[machineInfo.cpu], machineInfo.performance[P0]);
+    }
+    double classesMs = lap();
 
-    for(unsigned i = 0; i < active_machines; i++) {
-        machines.push_back(MachineId_t(i));
-        pendingMachineStates[MachineId_t(i)] = S0;
-    }    
+    pendingMachineStates.assign(active_machines, S0);
+    residentTasks.resize(active_machines);
+    projectedDrain.resize(active_machines, 0);
+    corePStates.resize(active_machines);
+    longPool.resize(active_machines, false);
+    longResidents.resize(active_machines, 0);
+    transitioning.resize(active_machines, false);
+    wakingTasks.resize(active_machines);
+    reservedMemory.resize(active_machines, 0);
+    wakeStart.resize(active_machines, 0);
+    wakeFrom.resize(active_machines, S0);
+    machineVMs.resize(active_machines);
+    vm_capacity.resize(active_machines, 0);
+    machine_power.resize(active_machines, 0);
+    capped_pstate.resize(active_machines, P0);
+    energy_model.Init(active_machines);
+    eachMachine([&](unsigned i) {
+        corePStates[i].assign(infos[i].num_cpus, P0);
+        energy_model.Add(infos[i]);
+    });
+    migrations.Init(active_machines, MIGRATIONS_IN_FLIGHT, MIGRATIONS_PER_SOURCE, MIGRATIONS_PER_DESTINATION,
+                    MIGRATION_LATENCY, MIGRATION_BANDWIDTH);
+    double modelsMs = lap();
+
+    // identical machines score the same, so rank classes, not machines.
+    // a class keeps its machines in id order
+    vector<unsigned> classOrder(machine_classes.Count());
+    vector<float> classScores;
+    for (unsigned cls = 0; cls < machine_classes.Count(); cls++) {
+        classOrder[cls] = cls;
+        classScores.push_back(scoreEfficiency(machine_classes.Members(cls).front()));
+        cout << "efficiency for class " << cls << " (" << machine_classes.Members(cls).size() << " machines) is " << classScores.back() << endl;
+    }
+    std::stable_sort(classOrder.begin(), classOrder.end(), [&](unsigned a, unsigned b) {
+        return classScores[a] > classScores[b];     // descending
+    });
+    machines.clear();
+    machines.reserve(active_machines);
+    vector<float> efficiencies;
+    vector<unsigned> classOfRow;
+    efficiencies.reserve(active_machines);
+    classOfRow.reserve(active_machines);
+    for (unsigned cls : classOrder) {
+        const vector<MachineId_t> & members = machine_classes.Members(cls);
+        machines.insert(machines.end(), members.begin(), members.end());
+        efficiencies.insert(efficiencies.end(), members.size(), classScores[cls]);
+        classOfRow.insert(classOfRow.end(), members.size(), cls);
+    }
+    cluster_table.Init(machines, efficiencies, classOfRow);
+    standby.Init(cluster_table.Classes(), STANDBY_WAIT_TARGET);
+    double rankMs = lap();
 
+    // what refreshMachine would work out for each machine, in bulk: nothing
+    // is placed, reserved or migrating yet
+    machineRank.resize(active_machines);
+    dirty.resize(active_machines, false);
+    for (unsigned rank = 0; rank < machines.size(); rank++) {
+        machineRank[machines[rank]] = rank;
+        unparked.insert(unparked.end(), rank);
+    }
+    Time_t now = Now();
+    eachMachine([&](unsigned i) {
+        vm_capacity[i] = admissibleLoad(infos[i], now);
+        machine_power[i] = energy_model.Power(infos[i]);
+    });
+    parallelFor(cluster_table.Classes(), workers, [&](unsigned cls) {
+        cluster_table.FillClass(cls, infos, vm_capacity);
+    });
+    cluster_power = 0;
+    for (double power : machine_power) {
+        cluster_power += power;
+    }
+    double indicesMs = lap();
 
-    std::sort(machines.begin(), machines.end(), compareEnergyEfficiency);
-    for(auto machine: machines) {
-        cout << "efficiency for " << machine << " is " << scoreEfficiency(machine)  << endl;
+    if (async_planner_enabled) {
+        planner.Start();
     }
- }
+    if (timeline_enabled) {
+        timeline.Init(active_machines, TIMELINE_CAPACITY, TIMELINE_MAX_BYTES, timeline_downsample);
+    }
+    double startMs = lap();
+    cout << "Init: " << active_machines << " machines in " << machine_classes.Count() << " classes, "
+         << chrono::duration<double, milli>(mark - started).count() << " ms (params " << paramsMs << ", read " << readMs << ", classes " << classesMs
+         << ", models " << modelsMs << ", rank " << rankMs << ", indices " << indicesMs << ", start " << startMs << ")" << endl;
+}
 
 void Scheduler::MigrationComplete(Time_t time, VMId_t vm_id) {
     // Update your data structure. The VM now can receive new tasks
+    Migration_t done;
+    if (!migrations.Finish(vm_id, time, done)) {
+        return;
+    }
+
+    // the VM's entry and its tasks follow it to the destination
+    vector<HostedVM_t> & from = machineVMs[done.source];
+    auto entry = find_if(from.begin(), from.end(), [&](const HostedVM_t & hosted) { return hosted.vm == vm_id; });
+    MachineInfo_t machineInfo = Machine_GetInfo(done.destination);
+    double stretch = max(1.0, (double)machineInfo.active_tasks / (double)machineInfo.num_cpus);
+    vector<TaskId_t> tasks = VM_GetInfo(vm_id).active_tasks;
+    for (TaskId_t task_id : tasks) {
+        bool isLong = longTasks.count(task_id) > 0;
+        untrackTask(task_id);
+        if (isLong) {
+            longTasks.insert(task_id);
+        }
+        trackPlacement(task_id, done.destination, time + (Time_t)(energy_model.Runtime(done.destination, task_id, machineInfo.p_state) * stretch));
+    }
+    if (entry != from.end()) {
+        HostedVM_t moved = *entry;
+        from.erase(entry);
+        moved.tasks = tasks.size();
+        if (moved.tasks == 0) {
+            VM_Shutdown(vm_id);             // emptied out on the way
+        } else {
+            machineVMs[done.destination].push_back(moved);
+        }
+    }
+
+    for (MachineId_t machine : {done.source, done.destination}) {
+        if (per_core_dvfs_enabled) {
+            assignCores(machine, time);
+        }
+        refreshMachine(machine);
+        markDirty(machine);
+    }
 }
 
+// migrates every VM off source, or nothing if that doesn't pay
+bool Scheduler::drainMachine(MachineId_t source, Time_t now) {
+    unsigned sourceRank = machineRank[source];
+    vector<Migration_t> moves;
+    unordered_map<MachineId_t, unsigned> plannedIn;
+    unordered_map<MachineId_t, unsigned> plannedMemory;
+    double cost = 0;
+    Time_t lastLanding = now;
+    vector<MachineId_t> candidates(LOOKAHEAD_K);
 
-void Scheduler::handleQueue() {
-    if (task_queue.empty()) {
-        return; // exit if nothing to do
+    for (const HostedVM_t & hosted : machineVMs[source]) {
+        VMInfo_t vmInfo = VM_GetInfo(hosted.vm);
+        unsigned memory = VM_OVERHEAD;
+        for (TaskId_t task_id : vmInfo.active_tasks) {
+            memory += GetTaskMemory(task_id);
+        }
+        Time_t duration = migrations.Duration(memory);
+
+        bool placed = false;
+        unsigned count = cluster_table.Feasible(vmInfo.cpu, memory, ANY_POOL, candidates.data(), LOOKAHEAD_K);
+        for (unsigned i = 0; i < count && !placed; i++) {
+            MachineId_t destination = candidates[i];
+            if (machineRank[destination] >= sourceRank || cluster_table.SState(destination) != S0 || pendingMachineStates[destination] != S0 ||
+                transitioning[destination] || !migrations.CanStart(source, destination, moves.size(), plannedIn[destination])) {
+                continue;
+            }
+            MachineInfo_t machineInfo = reservedInfo(destination);
+            unsigned load = max(machineInfo.active_vms, machineInfo.active_tasks) + plannedIn[destination] + vmInfo.active_tasks.size();
+            if (load > vm_capacity[destination] + 1 ||
+                (int)machineInfo.memory_size - (int)machineInfo.memory_used - (int)plannedMemory[destination] < (int)memory) {
+                continue;
+            }
+            // the VM's tasks are stopped while it moves
+            double stretch = max(1.0, (double)load / (double)machineInfo.num_cpus);
+            bool onTime = true;
+            for (TaskId_t task_id : vmInfo.active_tasks) {
+                Time_t finish = now + duration + (Time_t)(energy_model.Runtime(destination, task_id, machineInfo.p_state) * stretch);
+                if (RequiredSLA(task_id) != SLA3 && finish > GetTaskInfo(task_id).target_completion) {
+                    onTime = false;
+                }
+            }
+            if (!onTime) {
+                continue;
+            }
+            moves.push_back({hosted.vm, source, destination, memory, now, duration});
+            plannedIn[destination]++;
+            plannedMemory[destination] += memory;
+            cost += migrations.Cost(energy_model, source, destination, memory);
+            lastLanding = max(lastLanding, now + duration);
+            placed = true;
+        }
+        if (!placed) {
+            return false;
+        }
     }
-    TaskId_t task_id = task_queue.top();
 
-    VMType_t  reqVM = RequiredVMType(task_id);
+    // what it buys: the source sleeps from the last landing until it would
+    // otherwise have drained
+    if (moves.empty() || projectedDrain[source] <= lastLanding) {
+        return false;
+    }
+    double watts = energy_model.StatePower(source, S0) - energy_model.StatePower(source, S5);
+    if (watts * (double)(projectedDrain[source] - lastLanding) / 1000000.0 <= cost) {
+        return false;
+    }
+    for (const Migration_t & move : moves) {
+        VM_Migrate(move.vm, move.destination);
+        migrations.Start(move.vm, source, move.destination, move.memory, now);
+        refreshMachine(move.destination);
+        markDirty(move.destination);
+    }
+    markDirty(source);
+    return true;
+}
+
+// slack a machine would have one P-state down: the least time any resident
+// with a deadline has to spare at that speed and today's load
+int64_t Scheduler::throttleSlack(MachineId_t machine, CPUPerformance_t p_state, Time_t now) {
+    MachineInfo_t machineInfo = Machine_GetInfo(machine);
+    double stretch = max(1.0, (double)machineInfo.active_tasks / (double)machineInfo.num_cpus);
+    int64_t slack = INT64_MAX;
+    for (TaskId_t task_id : residentTasks[machine]) {
+        if (RequiredSLA(task_id) == SLA3) {
+            continue;
+        }
+        Time_t runtime = (Time_t)(energy_model.Runtime(machine, task_id, p_state) * stretch);
+        slack = min(slack, (int64_t)GetTaskInfo(task_id).target_completion - (int64_t)now - (int64_t)runtime);
+    }
+    return slack;
+}
+
+void Scheduler::enforcePowerCap(Time_t now) {
+    bool capped = throttled_machines > 0 || sla3_held;
+    if (last_check > 0 && cluster_power > POWER_CAP_WATTS) {
+        time_over_cap += now - last_check;
+    }
+    if (last_check > 0 && capped) {
+        time_capped += now - last_check;
+    }
+    last_check = now;
+    peak_power = max(peak_power, cluster_power);
+
+    if (cluster_power > POWER_CAP_WATTS) {
+        // busy awake machines that can still slow down, most slack first
+        vector<pair<int64_t, MachineId_t>> candidates;
+        for (unsigned rank : unparked) {
+            MachineId_t machine = machines[rank];
+            CPUPerformance_t p_state = cluster_table.PState(machine);
+            if (cluster_table.SState(machine) != S0 || residentTasks[machine].empty() || p_state == P3) {
+                continue;
+            }
+            int64_t slack = throttleSlack(machine, CPUPerformance_t(p_state + 1), now);
+            if (slack > 0) {
+                candidates.push_back({slack, machine});
+            }
+        }
+        sort(candidates.begin(), candidates.end(), greater<pair<int64_t, MachineId_t>>());
+        for (unsigned i = 0; i < candidates.size() && cluster_power > POWER_CAP_WATTS; i++) {
+            MachineId_t machine = candidates[i].second;
+            CPUPerformance_t p_state = CPUPerformance_t(cluster_table.PState(machine) + 1);
+            if (capped_pstate[machine] == P0) {
+                throttled_machines++;
+            }
+            capped_pstate[machine] = p_state;
+            Machine_SetCorePerformance(machine, 0, p_state);
+            refreshMachine(machine);
+        }
+        sla3_held = cluster_power > POWER_CAP_WATTS;
+        return;
+    }
+
+    if (cluster_power >= POWER_CAP_WATTS * POWER_CAP_RESUME) {
+        return;
+    }
+    sla3_held = false;
+    // step throttled machines back up for as long as the estimate stays
+    // under the resume level
+    for (unsigned rank = 0; rank < machines.size() && throttled_machines > 0; rank++) {
+        MachineId_t machine = machines[rank];
+        if (capped_pstate[machine] == P0) {
+            continue;
+        }
+        MachineInfo_t machineInfo = Machine_GetInfo(machine);
+        CPUPerformance_t p_state = CPUPerformance_t(capped_pstate[machine] - 1);
+        unsigned busy = min(machineInfo.active_tasks, machineInfo.num_cpus);
+        double extra = machineInfo.s_state == S0 ? busy * (energy_model.CorePower(machine, p_state) - energy_model.CorePower(machine, capped_pstate[machine])) : 0;
+        if (cluster_power + extra >= POWER_CAP_WATTS * POWER_CAP_RESUME) {
+            break;
+        }
+        capped_pstate[machine] = p_state;
+        if (p_state == P0) {
+            throttled_machines--;
+        }
+        if (per_core_dvfs_enabled) {
+            assignCores(machine, now);
+        } else if (machineInfo.p_state > p_state) {
+            Machine_SetCorePerformance(machine, 0, p_state);
+        }
+        refreshMachine(machine);
+    }
+}
+
+// idle machines a class has at or above tier, counting those already on
+// their way there
+unsigned Scheduler::idleAtOrAbove(unsigned cls, MachineState_t tier) {
+    unsigned count = 0;
+    for (unsigned rank = cluster_table.ClassBegin(cls); rank < cluster_table.ClassEnd(cls); rank++) {
+        MachineId_t machine = machines[rank];
+        if (residentTasks[machine].empty() && wakingTasks[machine].empty() && pendingMachineStates[machine] <= tier) {
+            count++;
+        }
+    }
+    return count;
+}
+
+void Scheduler::planStandby(ClusterSnapshot_t & snapshot) {
+    unsigned classes = cluster_table.Classes();
+    vector<unsigned> instant(classes), fast(classes);
+    for (unsigned cls = 0; cls < classes; cls++) {
+        MachineId_t first = machines[cluster_table.ClassBegin(cls)];
+        unsigned size = cluster_table.ClassEnd(cls) - cluster_table.ClassBegin(cls);
+        // a taken instant host is refilled from the fast tier, a fast one
+        // from deep sleep
+        instant[cls] = standby.TierSize(cls, energy_model.WakeLatency(first, FAST_TIER), size);
+        fast[cls] = standby.TierSize(cls, energy_model.WakeLatency(first, DEEP_TIER), size - instant[cls]);
+    }
+
+    // the most efficient idle machines stay shallow
+    vector<unsigned> inInstant(classes, 0), inFast(classes, 0);
+    for (MachineSnapshot_t & entry : snapshot.machines) {
+        if (entry.active_tasks > 0 || entry.busy) {
+            continue;
+        }
+        unsigned cls = cluster_table.ClassOf(entry.rank);
+        if (inInstant[cls] < instant[cls]) {
+            entry.deepest = INSTANT_TIER;
+            inInstant[cls]++;
+        } else if (inFast[cls] < fast[cls]) {
+            entry.deepest = FAST_TIER;
+            inFast[cls]++;
+        }
+    }
+
+    // a tier still short (the snapshot only has the machines the planner
+    // may touch) gets one parked machine a check
+    for (unsigned cls = 0; cls < classes; cls++) {
+        if (inInstant[cls] >= instant[cls] && inFast[cls] >= fast[cls]) {
+            continue;
+        }
+        MachineState_t tier = DEEP_TIER;
+        if (idleAtOrAbove(cls, INSTANT_TIER) < instant[cls]) {
+            tier = INSTANT_TIER;
+        } else if (idleAtOrAbove(cls, FAST_TIER) < instant[cls] + fast[cls]) {
+            tier = FAST_TIER;
+        }
+        auto rank = parked.lower_bound(cluster_table.ClassBegin(cls));
+        if (tier != DEEP_TIER && rank != parked.end() && *rank < cluster_table.ClassEnd(cls)) {
+            requestState(machines[*rank], tier);
+        }
+    }
+}
+
+// wakes the machines the plan wants up soon and keeps the planner off them.
+// the walk stops once the plan is covered, so it is as long as the plan
+void Scheduler::followPlan(Time_t now, ClusterSnapshot_t & snapshot) {
+    vector<unsigned> keepBelow(cluster_table.Classes(), 0);     // by class, a rank bound
+    for (unsigned c = 0; c < 4; c++) {
+        CPUType_t cpu = CPUType_t(c);
+        if (!capacity_plan.Covers(cpu)) {
+            continue;
+        }
+        // reactive correction, for a workload that runs off its plan. a
+        // step that rises is planned for its peak, and the tasks running
+        // trail that all the way up, so it is not scaled down
+        CapacityStep_t step = capacity_plan.At(cpu, now);
+        if (step.start != plan_step[c]) {
+            plan_rising[c] = step.slots > capacity_plan.At(cpu, plan_step[c]).slots;
+            plan_step[c] = step.start;
+        }
+        // no more can run than the plan has slots for
+        double expected = min(step.tasks, (double)step.slots);
+        if (plan_rising[c]) {
+            plan_correction[c] = max(plan_correction[c], 1.0);
+        } else if (expected >= 1) {
+            double ratio = min(PLAN_CORRECTION_MAX, max(1 / PLAN_CORRECTION_MAX, running_tasks[c] / expected));
+            plan_correction[c] += PLAN_SMOOTHING * (ratio - plan_correction[c]);
+        }
+
+        Time_t wake = 0;
+        for (unsigned cls = 0; cls < cluster_table.Classes(); cls++) {
+            if (cluster_table.ClassCPU(cls) == cpu) {
+                wake = max(wake, energy_model.WakeLatency(machines[cluster_table.ClassBegin(cls)], DEEP_TIER));
+            }
+        }
+        // the correction is for the level in effect. a rise coming up is
+        // woken for in full, there is nothing to correct it by yet
+        unsigned current = step.slots;
+        unsigned ahead = capacity_plan.Peak(cpu, now, now + wake + PLAN_LEAD);
+        double need = current * plan_correction[c] + (ahead > current ? ahead - current : 0);
+
+        double covered = 0;
+        for (unsigned cls = 0; cls < cluster_table.Classes() && covered < need; cls++) {
+            if (cluster_table.ClassCPU(cls) != cpu) {
+                continue;
+            }
+            unsigned rank = cluster_table.ClassBegin(cls);
+            for (; rank < cluster_table.ClassEnd(cls) && covered < need; rank++) {
+                MachineId_t machine = machines[rank];
+                if (pendingMachineStates[machine] != S0) {
+                    requestState(machine, S0);
+                }
+                covered += max(1u, vm_capacity[machine]);
+            }
+            keepBelow[cls] = rank;
+        }
+    }
+
+    for (MachineSnapshot_t & entry : snapshot.machines) {
+        if (entry.rank < keepBelow[cluster_table.ClassOf(entry.rank)]) {
+            entry.deepest = S0;
+        }
+    }
+}
+
+void Scheduler::planMigrations(Time_t now) {
+    unsigned considered = 0;
+    for (auto rank = unparked.rbegin(); rank != unparked.rend() && considered < MIGRATION_CANDIDATES; ++rank) {
+        MachineId_t source = machines[*rank];
+        if (machineVMs[source].empty() || migrations.Involved(source) || transitioning[source] || !wakingTasks[source].empty() ||
+            pendingMachineStates[source] != S0 || cluster_table.SState(source) != S0) {
+            continue;
+        }
+        considered++;
+        drainMachine(source, now);
+    }
+}
+
+
+bool canHost(const MachineInfo_t & machineInfo, CPUType_t reqCPU, unsigned reqMemory) {
+    unsigned memRemaining = machineInfo.memory_size - machineInfo.memory_used;
+    return !(machineInfo.cpu != reqCPU || (int)memRemaining - (int)reqMemory - (int)VM_OVERHEAD < 0 || max(machineInfo.active_vms, machineInfo.active_tasks) > vm_capacity[machineInfo.machine_id]);
+}
+
+// an open VM of the task's type and SLA on the machine, if the task can
+// share one without missing its deadline
+bool Scheduler::joinVM(TaskId_t task_id, const MachineInfo_t & machineInfo, Time_t now, VMId_t & vm) {
+    SLAType_t reqSLA = RequiredSLA(task_id);
+    if (reqSLA == SLA0) {
+        return false;
+    }
+    MachineId_t machine = machineInfo.machine_id;
+    if (reqSLA != SLA3) {
+        double stretch = max(1.0, (double)(machineInfo.active_tasks + 1) / (double)machineInfo.num_cpus);
+        Time_t finish = now + (Time_t)(energy_model.Runtime(machine, task_id, machineInfo.p_state) * stretch);
+        if (finish > GetTaskInfo(task_id).target_completion) {
+            return false;
+        }
+    }
+    VMType_t reqVM = RequiredVMType(task_id);
+    for (const HostedVM_t & hosted : machineVMs[machine]) {
+        if (hosted.vm_type == reqVM && hosted.sla == reqSLA && hosted.tasks < TASKS_PER_VM && !migrations.InFlight(hosted.vm)) {
+            vm = hosted.vm;
+            return true;
+        }
+    }
+    return false;
+}
+
+// the simulator has already taken the task off its VM. an empty VM is shut
+// down, which hands its memory overhead and VM slot back to the machine
+void Scheduler::releaseVM(TaskId_t task_id, MachineId_t machine) {
+    auto it = taskVM.find(task_id);
+    if (it == taskVM.end()) {
+        return;
+    }
+    VMId_t vm = it->second;
+    taskVM.erase(it);
+    vector<HostedVM_t> & hosted = machineVMs[machine];
+    for (auto entry = hosted.begin(); entry != hosted.end(); entry++) {
+        if (entry->vm != vm) {
+            continue;
+        }
+        entry->tasks = VM_GetInfo(vm).active_tasks.size();
+        // a VM on the move is shut down once it lands
+        if (entry->tasks == 0 && !migrations.InFlight(vm)) {
+            VM_Shutdown(vm);
+            hosted.erase(entry);
+        }
+        return;
+    }
+}
+
+// issues a state change unless the machine is already headed there. asking
+// again while a transition is in flight restarts it in the simulator. the
+// table is updated first since asking for the state the machine reports
+// completes on the spot, from inside Machine_SetState
+void Scheduler::requestState(MachineId_t machine, MachineState_t state) {
+    if (pendingMachineStates[machine] == state) {
+        return;
+    }
+    // only a wake from a settled state says what that state costs
+    bool settled = !transitioning[machine] && cluster_table.SState(machine) > S0;
+    wakeFrom[machine] = state == S0 && settled ? cluster_table.SState(machine) : S0;
+    wakeStart[machine] = Now();
+    pendingMachineStates[machine] = state;
+    transitioning[machine] = true;
+    markDirty(machine);
+    setParked(machine, false);
+    Machine_SetState(machine, state);
+}
+
+void Scheduler::markDirty(MachineId_t machine) {
+    if (!dirty[machine]) {
+        dirty[machine] = true;
+        dirtyMachines.push_back(machine);
+    }
+}
+
+void Scheduler::setParked(MachineId_t machine, bool isParked) {
+    unsigned rank = machineRank[machine];
+    if (isParked) {
+        unparked.erase(rank);
+        parked.insert(rank);
+    } else {
+        parked.erase(rank);
+        unparked.insert(rank);
+    }
+}
+
+// every machine, or with dirty checks just the dirty ones and this check's
+// slice of the sweep, most efficient first. clears the dirty set
+vector<MachineId_t> Scheduler::machinesToCheck(bool all) {
+    vector<unsigned> ranks;
+    if (all || !dirty_checks_enabled) {
+        ranks.resize(machines.size());
+        for (unsigned rank = 0; rank < machines.size(); rank++) {
+            ranks[rank] = rank;
+        }
+    } else {
+        for (MachineId_t machine : dirtyMachines) {
+            ranks.push_back(machineRank[machine]);
+        }
+        for (unsigned i = 0; i < SWEEP_PER_CHECK && i < machines.size(); i++) {
+            ranks.push_back(sweepCursor);
+            sweepCursor = (sweepCursor + 1) % machines.size();
+        }
+        sort(ranks.begin(), ranks.end());
+        ranks.erase(unique(ranks.begin(), ranks.end()), ranks.end());
+    }
+
+    for (MachineId_t machine : dirtyMachines) {
+        dirty[machine] = false;
+    }
+    dirtyMachines.clear();
+
+    vector<MachineId_t> check;
+    check.reserve(ranks.size());
+    for (unsigned rank : ranks) {
+        check.push_back(machines[rank]);
+    }
+    return check;
+}
+
+void Scheduler::refreshMachine(MachineId_t machine) {
+    refreshMachine(Machine_GetInfo(machine));
+}
+
+void Scheduler::refreshMachine(const MachineInfo_t & machineInfo) {
+    MachineId_t machine = machineInfo.machine_id;
+    vm_capacity[machine] = admissibleLoad(machineInfo, Now());
+    double power = energy_model.Power(machineInfo);
+    cluster_power += power - machine_power[machine];
+    machine_power[machine] = power;
+    cluster_table.Update(machineInfo, reservedMemory[machine] + migrations.IncomingMemory(machine),
+                         wakingTasks[machine].size() + migrations.Incoming(machine), vm_capacity[machine], longPool[machine]);
+}
+
+// VMS_PER_CORE per core, or with oversubscription on, as many tasks as the
+// residents' deadlines leave room for. each resident's pace so far (work done
+// since arrival) gives its remaining time at today's load, and finishing by
+// the deadline with oversub_margin to spare caps how much busier the machine
+// can get. a resident that has not made progress yet can't be judged, so the
+// machine stays at the base. SLA3 has no deadline to keep
+unsigned Scheduler::admissibleLoad(const MachineInfo_t & machineInfo, Time_t now) {
+    unsigned base = (unsigned)(machineInfo.num_cpus * VMS_PER_CORE);
+    if (!oversub_enabled) {
+        return base;
+    }
+    double load = (double)max(machineInfo.active_tasks, machineInfo.num_cpus) / (double)machineInfo.num_cpus;
+    double perCore = OVERSUB_MAX_PER_CORE;
+    for (TaskId_t task_id : residentTasks[machineInfo.machine_id]) {
+        TaskInfo_t taskInfo = GetTaskInfo(task_id);
+        if (taskInfo.required_sla == SLA3) {
+            continue;
+        }
+        uint64_t done = taskInfo.total_instructions - taskInfo.remaining_instructions;
+        if (taskInfo.target_completion <= now || done == 0 || now <= taskInfo.arrival) {
+            return base;
+        }
+        double remaining = (double)taskInfo.remaining_instructions * (double)(now - taskInfo.arrival) / (double)done;
+        if (remaining > 0) {
+            perCore = min(perCore, load * (double)(taskInfo.target_completion - now) / (remaining * oversub_margin));
+        }
+    }
+    return max(base, (unsigned)(machineInfo.num_cpus * perCore));
+}
+
+// machine info with the tasks already waiting for it to wake counted in, so
+// they don't all pile onto the same machine
+MachineInfo_t Scheduler::reservedInfo(MachineId_t machine) {
+    MachineInfo_t machineInfo = Machine_GetInfo(machine);
+    machineInfo.memory_used += reservedMemory[machine] + migrations.IncomingMemory(machine);
+    machineInfo.active_vms += wakingTasks[machine].size() + migrations.Incoming(machine);
+    machineInfo.active_tasks += wakingTasks[machine].size() + migrations.Incoming(machine);
+    return machineInfo;
+}
+
+// runtime estimate at arrival: the larger of the instructions on the fastest
+// host of the task's CPU type, and the runtime implied by its deadline window
+bool isLongTask(TaskId_t task_id) {
+    TaskInfo_t taskInfo = GetTaskInfo(task_id);
+    Time_t onFastest = taskInfo.total_instructions / fastest_mips[taskInfo.required_cpu];
+    Time_t fromDeadline = (Time_t)((taskInfo.target_completion - taskInfo.arrival) / SLA_WINDOW_FACTOR[taskInfo.required_sla]);
+    return max(onFastest, fromDeadline) >= LONG_TASK_RUNTIME;
+}
+
+bool Scheduler::inPool(MachineId_t machine, Pool_t pool) {
+    return pool == ANY_POOL || longPool[machine] == (pool == LONG_POOL);
+}
+
+void Scheduler::trackPlacement(TaskId_t task_id, MachineId_t machine, Time_t finish) {
+    if (longTasks.count(task_id)) {
+        longResidents[machine]++;
+        longPool[machine] = true;
+    }
+    residentTasks[machine].push_back(task_id);
+    running_tasks[RequiredCPUType(task_id)]++;
+    taskMachine[task_id] = machine;
+    projectedFinish[task_id] = finish;
+    projectedDrain[machine] = max(projectedDrain[machine], finish);
+}
+
+void Scheduler::untrackTask(TaskId_t task_id) {
+    auto it = taskMachine.find(task_id);
+    if (it == taskMachine.end()) {
+        return;
+    }
+    MachineId_t machine = it->second;
+    taskMachine.erase(it);
+    running_tasks[RequiredCPUType(task_id)]--;
+    if (longTasks.erase(task_id) && --longResidents[machine] == 0) {
+        longPool[machine] = false;      // last long task gone, hand it back
+    }
+    projectedFinish.erase(task_id);
+    taskCore.erase(task_id);
+
+    vector<TaskId_t> & residents = residentTasks[machine];
+    residents.erase(std::remove(residents.begin(), residents.end(), task_id), residents.end());
+
+    // drain time is the latest projected finish of whatever is left
+    projectedDrain[machine] = 0;
+    for (TaskId_t resident : residents) {
+        projectedDrain[machine] = max(projectedDrain[machine], projectedFinish[resident]);
+    }
+}
+
+// time a task has left before its deadline once its remaining work is done at P0
+static int64_t taskSlack(TaskId_t task_id, MachineId_t machine, Time_t now) {
+    TaskInfo_t taskInfo = GetTaskInfo(task_id);
+    return (int64_t)taskInfo.target_completion - (int64_t)now - (int64_t)energy_model.Runtime(machine, task_id, P0);
+}
+
+// groups the machine's tasks onto cores by slack, tightest first, so relaxed
+// tasks share cores with other relaxed tasks. each core then gets the
+// cheapest P-state that still meets every deadline on it, with the tasks
+// sharing the core run earliest-deadline-first
+void Scheduler::assignCores(MachineId_t machine, Time_t now) {
+    vector<TaskId_t> tasks = residentTasks[machine];
+    vector<CPUPerformance_t> & cores = corePStates[machine];
+    if (tasks.empty()) {
+        return;
+    }
+    sort(tasks.begin(), tasks.end(), [&](TaskId_t a, TaskId_t b) {
+        return taskSlack(a, machine, now) < taskSlack(b, machine, now);
+    });
+
+    unsigned perCore = (tasks.size() + cores.size() - 1) / cores.size();
+    vector<CPUPerformance_t> wanted(cores.size(), P3);
+    for (unsigned core = 0; core < cores.size(); core++) {
+        unsigned first = core * perCore;
+        unsigned last = min((unsigned)tasks.size(), first + perCore);
+        if (first >= last) {
+            continue;       // idle core, left at the slowest state
+        }
+
+        vector<TaskId_t> group(tasks.begin() + first, tasks.begin() + last);
+        sort(group.begin(), group.end(), [](TaskId_t a, TaskId_t b) {
+            return GetTaskInfo(a).target_completion < GetTaskInfo(b).target_completion;
+        });
+
+        uint64_t instructions = 0;
+        for (TaskId_t task_id : group) {
+            taskCore[task_id] = core;
+            TaskInfo_t taskInfo = GetTaskInfo(task_id);
+            instructions += taskInfo.remaining_instructions;
+
+            // slowing down only pays while the machine is held awake by
+            // something else anyway, so never stretch past its drain point
+            Time_t budget = projectedDrain[machine] > now ? projectedDrain[machine] - now : 0;
+            if (RequiredSLA(task_id) != SLA3) {
+                Time_t deadline = taskInfo.target_completion > now ? taskInfo.target_completion - now : 0;
+                budget = min(budget, (Time_t)(deadline * DVFS_SLACK_MARGIN));
+            }
+            wanted[core] = min(wanted[core], energy_model.CheapestPState(machine, instructions, budget));
+        }
+    }
+
+    // under a power cap, nothing runs faster than the cap allows
+    for (CPUPerformance_t & p_state : wanted) {
+        p_state = max(p_state, capped_pstate[machine]);
+    }
+
+    // the simulator applies a core's P-state to every core on the machine,
+    // so whenever anything changes the strictest core is issued last
+    unsigned strictest = min_element(wanted.begin(), wanted.end()) - wanted.begin();
+    bool changed = false;
+    for (unsigned core = 0; core < cores.size(); core++) {
+        if (core != strictest && wanted[core] != cores[core]) {
+            Machine_SetCorePerformance(machine, core, wanted[core]);
+            changed = true;
+        }
+        cores[core] = wanted[core];
+    }
+    if (changed || Machine_GetInfo(machine).p_state != wanted[strictest]) {
+        Machine_SetCorePerformance(machine, strictest, wanted[strictest]);
+    }
+}
+
+// projected energy (J) of running the task on this machine within the
+// horizon, with missing the target completion charged as if the machine's
+// baseline was wasted for the whole horizon
+double lookaheadCost(const MachineInfo_t & machineInfo, Time_t drain, TaskId_t task_id, Time_t now) {
+    MachineId_t machine = machineInfo.machine_id;
+    double cost = energy_model.PlaceEnergy(machine, task_id, machineInfo.p_state, machineInfo.active_tasks, drain, now, LOOKAHEAD_HORIZON);
+
+    double stretch = max(1.0, (double)(machineInfo.active_tasks + 1) / (double)machineInfo.num_cpus);
+    Time_t finish = now + (Time_t)(energy_model.Runtime(machine, task_id, machineInfo.p_state) * stretch);
+    SLAType_t sla = RequiredSLA(task_id);
+    if (sla != SLA3 && finish > GetTaskInfo(task_id).target_completion) {
+        cost += energy_model.IdleEnergy(machine, S0, LOOKAHEAD_HORIZON) * (NUM_SLAS - sla);
+    }
+    return cost;
+}
+
+// scores the first K feasible machines (in efficiency order) and returns the
+// cheapest in best. stops early once the time budget for the decision is spent
+bool Scheduler::lookaheadPick(TaskId_t task_id, Time_t now, Pool_t pool, MachineId_t & best) {
+    auto start = chrono::steady_clock::now();
+    CPUType_t reqCPU = RequiredCPUType(task_id);
+    unsigned reqMemory = GetTaskMemory(task_id);
+
+    vector<MachineId_t> candidates(LOOKAHEAD_K);
+    unsigned count = cluster_table.Feasible(reqCPU, reqMemory + VM_OVERHEAD, pool, candidates.data(), LOOKAHEAD_K);
+
+    bool found = false;
+    double bestCost = 0;
+    unsigned scored = 0;
+    for (unsigned i = 0; i < count; i++) {
+        MachineId_t machine = candidates[i];
+        MachineInfo_t machineInfo = reservedInfo(machine);
+        if (!canHost(machineInfo, reqCPU, reqMemory)) {
+            refreshMachine(machine);        // stale row
+            continue;
+        }
+
+        double cost = lookaheadCost(machineInfo, projectedDrain[machine], task_id, now);
+        // a machine already waking for other tasks has paid for it
+        if (pendingMachineStates[machine] > S0 || (machineInfo.s_state > S0 && wakingTasks[machine].empty())) {
+            cost += energy_model.WakeEnergy(machine, machineInfo.s_state);
+        }
+        if (!found || cost < bestCost) {
+            found = true;
+            bestCost = cost;
+            best = machine;
+        }
+
+        scored++;
+        auto elapsed = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+        if (scored >= LOOKAHEAD_K || elapsed >= LOOKAHEAD_BUDGET_US) {
+            break;
+        }
+    }
+    return found;
+}
+
+// iterate through machines from most efficient to least efficient
+// and find one to allocate tasks to 
+bool Scheduler::pickMachine(TaskId_t task_id, Time_t now, Pool_t pool, MachineId_t & machine) {
+    if (lookahead_enabled) {
+        return lookaheadPick(task_id, now, pool, machine);
+    }
     CPUType_t reqCPU = RequiredCPUType(task_id);
     unsigned reqMemory = GetTaskMemory(task_id);
+    MachineId_t candidate;
+    for (unsigned tries = 0; tries < machines.size(); tries++) {
+        if (cluster_table.Feasible(reqCPU, reqMemory + VM_OVERHEAD, pool, &candidate, 1) == 0) {
+            break;
+        }
+        if (canHost(reservedInfo(candidate), reqCPU, reqMemory)) {
+            machine = candidate;
+            return true;
+        }
+        refreshMachine(candidate);          // stale row, fix it and look again
+    }
+    return false;
+}
+
+// creates a VM for the task on an awake machine and starts it there
+void Scheduler::placeTask(TaskId_t task_id, MachineId_t machine, Time_t now) {
+    MachineInfo_t machineInfo = Machine_GetInfo(machine);
+    VMType_t  reqVM = RequiredVMType(task_id);
+    CPUType_t reqCPU = RequiredCPUType(task_id);
     SLAType_t reqSLA = RequiredSLA(task_id);
 
     Priority_t priority = MID_PRIORITY;
@@ -114,64 +1191,293 @@ void Scheduler::handleQueue() {
         priority = LOW_PRIORITY;
     }
 
+    // create VM for task (unless it can share one) and add task
+    VMId_t vm;
+    if (!(vm_packing_enabled && joinVM(task_id, machineInfo, now, vm))) {
+        vm = VM_Create(reqVM, reqCPU);
+        VM_Attach(vm, machine);
+        machineVMs[machine].push_back({vm, reqVM, reqSLA, 0});
+    }
+    for (HostedVM_t & hosted : machineVMs[machine]) {
+        if (hosted.vm == vm) {
+            hosted.tasks++;
+        }
+    }
+    taskVM[task_id] = vm;
 
-    // iterate through machines from most efficient to least efficient
-    // and find one to allocate tasks to 
-    for (MachineId_t machine : machines) {
-        MachineInfo_t machineInfo = Machine_GetInfo(machine);
+    VM_AddTask(vm, task_id, priority);
+    if (task_report_enabled) {
+        task_report.Dispatch(task_id, now);
+    }
 
-        unsigned memRemaining = machineInfo.memory_size - machineInfo.memory_used;
-        if (machineInfo.cpu != reqCPU || (int)memRemaining - (int)reqMemory - (int)VM_OVERHEAD < 0 || (float)machineInfo.active_vms > (float)(machineInfo.num_cpus) * (1.0)) {
-            continue;
+    if (residentTasks[machine].empty()) {
+        standby.ObserveDemand(cluster_table.ClassOf(machineRank[machine]));
+    }
+    double stretch = max(1.0, (double)(machineInfo.active_tasks + 1) / (double)machineInfo.num_cpus);
+    trackPlacement(task_id, machine, now + (Time_t)(energy_model.Runtime(machine, task_id, machineInfo.p_state) * stretch));
+    if (per_core_dvfs_enabled) {
+        assignCores(machine, now);
+    }
+    refreshMachine(machine);
+    markDirty(machine);
+}
+
+// packs deferred SLA3 tasks onto awake machines, fullest first, so they use
+// as few hosts as possible. tasks that have waited too long go through the
+// normal queue instead, which will wake a machine for them if it has to
+void Scheduler::releaseDeferred(Time_t now) {
+    if (deferredTasks.empty() || sla3_held) {
+        return;
+    }
+
+    // a parked machine is asleep, so only the unparked ones can take them
+    vector<MachineId_t> awake;
+    for (unsigned rank : unparked) {
+        MachineId_t machine = machines[rank];
+        if (pendingMachineStates[machine] == S0 && cluster_table.SState(machine) == S0) {
+            awake.push_back(machine);
         }
+    }
 
-        // special case error: machine sleeping when it's needed
-        if (pendingMachineStates[machine] > S0 || machineInfo.s_state > S0) {
-            // re-enable machine
-            Machine_SetState(machine, S0);
-            pendingMachineStates[machine] = S0;
-            // cout << "restarting machine " << machine << endl;
-            reverse_limit -= 10; // prevent any more machines from being powered down
-            return;
+    vector<TaskId_t> waiting;
+    for (TaskId_t task_id : deferredTasks) {
+        CPUType_t reqCPU = RequiredCPUType(task_id);
+        unsigned reqMemory = GetTaskMemory(task_id);
+
+        bool found = false;
+        MachineId_t fullest = 0;
+        unsigned fullestTasks = 0;
+        for (MachineId_t machine : awake) {
+            MachineInfo_t machineInfo = Machine_GetInfo(machine);
+            if (canHost(machineInfo, reqCPU, reqMemory) && (!found || machineInfo.active_tasks > fullestTasks)) {
+                found = true;
+                fullest = machine;
+                fullestTasks = machineInfo.active_tasks;
+            }
+        }
+
+        if (found) {
+            placeTask(task_id, fullest, now);
+        } else if (now - GetTaskInfo(task_id).arrival >= SLA3_MAX_DEFERRAL) {
+            task_queue.push(task_id);
+        } else {
+            waiting.push_back(task_id);
         }
-        
-        // create VM for task and add task
-        VMId_t newVM = VM_Create(reqVM, reqCPU);
-        VM_Attach(newVM, machine);
-        vms.push_back(newVM);
+    }
+    deferredTasks.swap(waiting);
+}
 
+// refills a machine that just freed capacity with the highest priority
+// queued tasks that fit on it. bounded by COMPLETION_SCAN so a completion
+// never rescans the whole queue; tasks that don't fit keep their place.
+// this runs inside the simulator's task-finish path, which hands the freed
+// core to the machine's own backlog afterwards, so only idle cores are
+// filled and nothing is queued behind them
+void Scheduler::fillMachine(MachineId_t machine, Time_t now) {
+    if (task_queue.empty() || pendingMachineStates[machine] != S0 || transitioning[machine]) {
+        return;
+    }
+    MachineInfo_t machineInfo = Machine_GetInfo(machine);
+    if (machineInfo.s_state != S0) {
+        return;
+    }
 
-        VM_AddTask(newVM, task_id, priority);
+    vector<TaskId_t> skipped;
+    for (unsigned scanned = 0; scanned < COMPLETION_SCAN && !task_queue.empty(); scanned++) {
+        if (machineInfo.active_tasks >= machineInfo.num_cpus) {
+            break;      // no idle core left
+        }
+        TaskId_t task_id = task_queue.top();
         task_queue.pop();
+        if (canHost(machineInfo, RequiredCPUType(task_id), GetTaskMemory(task_id))) {
+            placeTask(task_id, machine, now);
+            machineInfo = Machine_GetInfo(machine);
+        } else {
+            skipped.push_back(task_id);
+        }
+    }
+    for (TaskId_t task_id : skipped) {
+        task_queue.push(task_id);
+    }
+}
+
+void Scheduler::handleQueue() {
+    if (task_queue.empty()) {
+        return; // exit if nothing to do
+    }
+    TaskId_t task_id = task_queue.top();
+    Time_t now = Now();
 
+    // long tasks go to the long-lived pool, which grows onto any machine
+    // when it is full. short tasks spill over onto it rather than wait
+    bool found = false;
+    MachineId_t machine = 0;
+    if (segregation_enabled) {
+        bool isLong = longTasks.count(task_id) > 0;
+        found = pickMachine(task_id, now, isLong ? LONG_POOL : SHORT_POOL, machine);
+        if (!found) {
+            found = pickMachine(task_id, now, ANY_POOL, machine);
+        }
+    } else {
+        found = pickMachine(task_id, now, ANY_POOL, machine);
+    }
 
+    if (found) {
+        MachineInfo_t machineInfo = Machine_GetInfo(machine);
+
+        task_queue.pop();
+
+        // special case: machine sleeping when it's needed. the task waits on
+        // it and goes out from StateChangeComplete once it's up, and the
+        // rest of the queue is free to wake other machines meanwhile. a
+        // machine still transitioning counts as asleep: a wake asked for
+        // mid power-down reads S0 until the power-down lands
+        if (transitioning[machine] || pendingMachineStates[machine] > S0 || machineInfo.s_state > S0) {
+            wakingTasks[machine].push_back(task_id);
+            reservedMemory[machine] += GetTaskMemory(task_id) + VM_OVERHEAD;
+            requestState(machine, S0);
+            refreshMachine(machine);
+            // cout << "restarting machine " << machine << endl;
+            reverse_limit -= WAKE_PENALTY; // prevent any more machines from being powered down
+            return;
+        }
+
+        placeTask(task_id, machine, now);
         return;
     }
 
     // oh no! no servers can handle task!! we have to ensure all
-    // servers are ramped back up
-    for (auto machine: machines) {
+    // servers that could take it are ramped back up. classes of another
+    // CPU type can't help
+    CPUType_t reqCPU = RequiredCPUType(task_id);
+    for (unsigned cls = 0; cls < cluster_table.Classes(); cls++) {
+        if (cluster_table.ClassCPU(cls) != reqCPU) {
+            continue;
+        }
+        for (unsigned rank = cluster_table.ClassBegin(cls); rank < cluster_table.ClassEnd(cls); rank++) {
+            MachineId_t machine = machines[rank];
+            MachineInfo_t machineInfo = Machine_GetInfo(machine);
+            if (pendingMachineStates[machine] > S0 || machineInfo.s_state > S0) {
+                requestState(machine, S0);
+            }
+            if (machineInfo.p_state > P0)
+                Machine_SetCorePerformance(machine, 0, CPUPerformance_t(0));
+        }
+    }
+}
+
+// places the whole queue at once on the awake machines (see Dispatcher).
+// tasks the plan leaves out, or that no longer fit by the time their VM is
+// created, go back on the queue for the serial path
+void Scheduler::dispatchBatch(Time_t now) {
+    vector<BatchTask_t> batch;
+    while (!task_queue.empty()) {
+        TaskId_t task_id = task_queue.top();
+        task_queue.pop();
+        batch.push_back({task_id, RequiredCPUType(task_id), (int32_t)(GetTaskMemory(task_id) + VM_OVERHEAD)});
+    }
+
+    // only classes with an awake machine that has a slot free are walked
+    vector<MachineId_t> open;
+    for (unsigned cls = 0; cls < cluster_table.Classes(); cls++) {
+        if (cluster_table.InState(cls, S0) > 0 && cluster_table.WithSlots(cls, 1) > 0) {
+            open.insert(open.end(), machines.begin() + cluster_table.ClassBegin(cls), machines.begin() + cluster_table.ClassEnd(cls));
+        }
+    }
+    vector<ShardMachine_t> awake;
+    for (MachineId_t machine : open) {
+        if (pendingMachineStates[machine] != S0 || transitioning[machine] || !wakingTasks[machine].empty() || cluster_table.SState(machine) != S0) {
+            continue;
+        }
         MachineInfo_t machineInfo = Machine_GetInfo(machine);
-        if (pendingMachineStates[machine] > S0 || machineInfo.s_state > S0) {
-            Machine_SetState(machine, S0);
-            pendingMachineStates[machine] = S0;
+        // canHost takes VMs until there are more than vm_capacity
+        awake.push_back({machine, machineInfo.cpu, (int32_t)machineInfo.memory_size - (int32_t)machineInfo.memory_used,
+                         (int32_t)vm_capacity[machine] + 1 - (int32_t)max(machineInfo.active_vms, machineInfo.active_tasks)});
+    }
+
+    for (const Assignment_t & assignment : dispatcher.Plan(awake, batch, SHARD_SIZE, DISPATCH_WORKERS)) {
+        TaskId_t task_id = assignment.task;
+        if (assignment.placed && canHost(Machine_GetInfo(assignment.machine), RequiredCPUType(task_id), GetTaskMemory(task_id))) {
+            placeTask(task_id, assignment.machine, now);
+        } else {
+            task_queue.push(task_id);
+        }
+    }
+}
+
+// repeatedly do task on queue (as long as it's actually dequeueing stuff)
+void Scheduler::drainQueue() {
+    if (parallel_dispatch_enabled && !segregation_enabled && task_queue.size() >= BURST_ARRIVALS) {
+        dispatchBatch(Now());
+    }
+    unsigned preHandleQueueSize;
+    do {
+        preHandleQueueSize = task_queue.size();
+        handleQueue();
+    } while(preHandleQueueSize > task_queue.size());
+}
+
+// hands the tasks that were waiting on a machine to it now that it is awake.
+// anything that no longer fits goes back on the queue
+void Scheduler::dispatchWaking(MachineId_t machine, Time_t now) {
+    vector<TaskId_t> waiting;
+    waiting.swap(wakingTasks[machine]);
+    reservedMemory[machine] = 0;
+    for (TaskId_t task_id : waiting) {
+        if (canHost(Machine_GetInfo(machine), RequiredCPUType(task_id), GetTaskMemory(task_id))) {
+            placeTask(task_id, machine, now);
+        } else {
+            task_queue.push(task_id);
         }
-        if (machineInfo.p_state > P0)
-            Machine_SetCorePerformance(machine, 0, CPUPerformance_t(0));
     }
+    refreshMachine(machine);
 }
 
 void Scheduler::NewTask(Time_t now, TaskId_t task_id) {
+    if (task_report_enabled) {
+        task_report.Arrive(task_id, now);
+    }
     // add the new task to queue
+    if (segregation_enabled && isLongTask(task_id)) {
+        longTasks.insert(task_id);
+    }
+    if ((sla3_deferral_enabled || sla3_held) && RequiredSLA(task_id) == SLA3) {
+        deferredTasks.push_back(task_id);
+        return;
+    }
     task_queue.push(task_id);
+    if (parallel_dispatch_enabled && !segregation_enabled && ++arrivals_this_check > BURST_ARRIVALS) {
+        // in a burst, hold arrivals until there is a batch worth placing
+        if (task_queue.size() >= BURST_ARRIVALS) {
+            drainQueue();
+        }
+        return;
+    }
     handleQueue();
 }
 
-MachineState_t getNextState(MachineState_t currentState) {
-    if (currentState < S5) {
-        return static_cast<MachineState_t>(currentState + 1);
-    } else {
-        return S5;
+// past 5% violations, stop trading SLA for energy altogether
+static bool slaBreached() {
+    return (double)(sla_violations) > (double)(GetNumTasks()) * SLA_BREACH_FRACTION;
+}
+
+// a plan made off-thread is at least a check old. drop it whole if demand
+// went up since (a wake pulled reverse_limit down, or work is queued), and
+// drop any step whose machine has moved on from what the plan saw
+void Scheduler::applyPowerPlan(const PowerPlan_t & plan) {
+    if (reverse_limit < plan.reverse_limit || !task_queue.empty() || slaBreached()) {
+        return;
+    }
+    for (const PowerStep_t & step : plan.steps) {
+        MachineId_t machine = step.machine;
+        if (pendingMachineStates[machine] != step.pending || transitioning[machine] || !wakingTasks[machine].empty() || migrations.Involved(machine)) {
+            continue;
+        }
+        MachineInfo_t machineInfo = Machine_GetInfo(machine);
+        if (machineInfo.s_state != step.from || machineInfo.active_tasks > 0) {
+            continue;
+        }
+        requestState(machine, step.to);
     }
 }
 
@@ -183,56 +1489,112 @@ void Scheduler::PeriodicCheck(Time_t now) {
     float taskPercentage = ((float)tasks_done / (float)GetNumTasks()) * 100;
     
 
+    // a timeline sample needs every machine
+    bool sampling = timeline_enabled && timeline.Begin(now);
+
     // periodic check for broken machines
-    for (auto machine: machines) {
+    for (auto machine: machinesToCheck(sampling)) {
         MachineInfo_t machineInfo = Machine_GetInfo(machine);
-        if(machineInfo.active_tasks > 0 && (machineInfo.s_state > S0 || pendingMachineStates[machine] > S0) ) {
+        refreshMachine(machineInfo);
+        if (sampling) {
+            timeline.Add(machineInfo);
+        }
+        if (pendingMachineStates[machine] == machineInfo.s_state) {
+            energy_model.Observe(machineInfo, now);
+            // in case a completion was missed for a machine tasks wait on
+            if (machineInfo.s_state == S0 && !wakingTasks[machine].empty()) {
+                transitioning[machine] = false;
+                dispatchWaking(machine, now);
+            }
+        }
+        // a power-down that landed after a wake was asked for is already
+        // being undone (see StateChangeComplete), and is not broken
+        bool rewaking = pendingMachineStates[machine] == S0 && transitioning[machine];
+        if(machineInfo.active_tasks > 0 && (machineInfo.s_state > S0 || pendingMachineStates[machine] > S0) && !rewaking) {
             cout << "machine off with tasks!!" << endl;
-            Machine_SetState(machine, S0);
-            pendingMachineStates[machine] = S0;
-            reverse_limit = -1000;
+            requestState(machine, S0);
+            reverse_limit = -BROKEN_PENALTY;
+        }
+        // keep looking at it until it settles
+        if (transitioning[machine] || !wakingTasks[machine].empty()) {
+            markDirty(machine);
         }
     }
+    if (sampling) {
+        timeline.End();
+    }
+
+    if (warnings_this_check == 0) {
+        oversub_margin = max(oversub_margin * OVERSUB_RELAX, OVERSUB_MARGIN);
+    }
+    warnings_this_check = 0;
                 
     // only allow more machine power-downs if
     //  - at least one machine will be running after
     //  - 10% of tasks have been done (stops it from getting ahead of itself)
-    if (reverse_limit + 1 < (int)(machines.size()) && taskPercentage >= 10) {
-        reverse_limit++;
+    //  - or a capacity plan says what is coming anyway
+    if (reverse_limit + 1 < (int)(machines.size()) && (taskPercentage >= POWER_DOWN_GATE || !capacity_plan.Empty())) {
+        reverse_limit = min(reverse_limit + REVERSE_STEP, (int)(machines.size()) - 1);
     }
 
     // if we violate an SLA, don't care abt efficiency anymore
     if (sla_violations > 0) {
-        for (auto machine: machines) {
-            MachineInfo_t machineInfo = Machine_GetInfo(machine);
-            if (pendingMachineStates[machine] > S0 || machineInfo.s_state > S0) {
-                Machine_SetState(machine, S0);
-                pendingMachineStates[machine] = S0;
+        vector<unsigned> asleep(parked.begin(), parked.end());
+        for (unsigned rank : asleep) {
+            requestState(machines[rank], S0);
+        }
+        for (unsigned rank : unparked) {
+            MachineId_t machine = machines[rank];
+            if (pendingMachineStates[machine] > S0 || cluster_table.SState(machine) > S0) {
+                requestState(machine, S0);
+            }
+            if (cluster_table.PState(machine) > capped_pstate[machine]) {
+                Machine_SetCorePerformance(machine, 0, capped_pstate[machine]);
+                refreshMachine(machine);
             }
-            if (machineInfo.p_state > P0)
-                Machine_SetCorePerformance(machine, 0, CPUPerformance_t(0));
         }
     }
 
-    int count_backwards = 0;
-    for (vector<MachineId_t>::reverse_iterator riter = machines.rbegin();
-        riter != machines.rend(); ++riter) 
-    { 
-        count_backwards += 1;
+    if (power_cap_enabled) {
+        enforcePowerCap(now);
+    }
 
-        // hit limit on machines allowed to be turned off
-        if (count_backwards >= reverse_limit || (float)(sla_violations) > (float)(GetNumTasks()) * (0.05)) {
-            break;
-        }
+    if (migration_enabled && sla_violations == 0) {
+        planMigrations(now);
+    }
 
-        MachineInfo_t mInfo = Machine_GetInfo(*riter);
-        auto nextState = getNextState(mInfo.s_state);
+    // power down idle machines, least efficient first (see Planner)
+    PowerPlan_t plan;
+    if (async_planner_enabled && planner.TakePlan(plan)) {
+        applyPowerPlan(plan);
+    }
 
-        if(mInfo.active_tasks == 0 && task_queue.empty() && nextState != pendingMachineStates[*riter]) {
-            Machine_SetState(*riter, nextState);
-            pendingMachineStates[*riter] = nextState; 
-        }
-    } 
+    // the planner only walks the reverse_limit least efficient machines, and
+    // has nothing to do with parked ones, so only those go in the snapshot
+    ClusterSnapshot_t snapshot;
+    for (auto rank = unparked.rbegin(); rank != unparked.rend() && (int)(machines.size() - *rank) < reverse_limit; ++rank) {
+        MachineId_t machine = machines[*rank];
+        bool busy = transitioning[machine] || !wakingTasks[machine].empty() || migrations.Involved(machine);
+        snapshot.machines.push_back({machine, *rank, cluster_table.SState(machine), pendingMachineStates[machine], (unsigned)residentTasks[machine].size(), busy, DEEP_TIER});
+    }
+    reverse(snapshot.machines.begin(), snapshot.machines.end());
+    standby.Tick(now);
+    if (standby_enabled && sla_violations == 0) {
+        planStandby(snapshot);
+    }
+    if (!capacity_plan.Empty() && sla_violations == 0) {
+        followPlan(now, snapshot);
+    }
+    snapshot.epoch = ++plan_epoch;
+    snapshot.num_machines = machines.size();
+    snapshot.queue_empty = task_queue.empty();
+    snapshot.reverse_limit = reverse_limit;
+    snapshot.sla_breached = slaBreached();
+    if (async_planner_enabled) {
+        planner.Submit(std::move(snapshot));
+    } else {
+        applyPowerPlan(Planner::PlanPowerSteps(snapshot));
+    }
 
 
     // for(auto machine: machines) {
@@ -242,13 +1604,12 @@ void Scheduler::PeriodicCheck(Time_t now) {
     cout << "--------" << endl;
 
 
-    // repeatedly do task on queue (as long as it's actually dequeueing stuff)
-    unsigned preHandleQueueSize;
-    do {
-        preHandleQueueSize = task_queue.size();
-        handleQueue();
-    } while(preHandleQueueSize > task_queue.size());
+    if (sla3_deferral_enabled || !deferredTasks.empty()) {
+        releaseDeferred(now);
+    }
 
+    arrivals_this_check = 0;
+    drainQueue();
 
     cout << taskPercentage << "\% tasks complete at time " << now << endl;
     cout << task_queue.size() << " tasks in queue | " << sla_violations << " violations " << endl;
@@ -259,8 +1620,11 @@ void Scheduler::Shutdown(Time_t time) {
     // Report about the total energy consumed
     // Report about the SLA compliance
     // Shutdown everything to be tidy :-)
-    for(auto & vm: vms) {
-        VM_Shutdown(vm);
+    planner.Stop();
+    for (auto & hosted : machineVMs) {
+        for (auto & vm : hosted) {
+            VM_Shutdown(vm.vm);
+        }
     }
     SimOutput("SimulationComplete(): Finished!", 4);
     SimOutput("SimulationComplete(): Time is " + to_string(time), 4);
@@ -272,18 +1636,58 @@ void Scheduler::TaskComplete(Time_t now, TaskId_t task_id) {
     // This is an opportunity to make any adjustments to optimize performance/energy
     SimOutput("Scheduler::TaskComplete(): Task " + to_string(task_id) + " is complete at " + to_string(now), 4);
     tasks_done += 1;
-
-    // shut down all inactive vms, delete em
-    for (auto it = vms.begin(); it != vms.end(); ) {
-        VMInfo_t vmInfo = VM_GetInfo(*it);
-        if (vmInfo.active_tasks.size() == 0) {
-            VM_Shutdown(*it);
-            it = vms.erase(it); 
-        } else {
-            it++; 
+    if (task_report_enabled) {
+        task_report.Complete(task_id, now);
+    }
+    auto placed = taskMachine.find(task_id);
+    bool tracked = placed != taskMachine.end();
+    MachineId_t machine = tracked ? placed->second : 0;
+    if (tracked) {
+        untrackTask(task_id);
+        releaseVM(task_id, machine);
+        if (per_core_dvfs_enabled) {
+            assignCores(machine, now);
         }
     }
 
+    // the machine's core and memory are free now (VM included), so put
+    // queued work on it instead of waiting for the next check
+    if (tracked) {
+        refreshMachine(machine);
+        markDirty(machine);
+    }
+    if (completion_dispatch_enabled && tracked) {
+        fillMachine(machine, now);
+    }
+}
+
+void Scheduler::StateChangeComplete(Time_t now, MachineId_t machine) {
+    // an older transition landed after a newer request completed (e.g. a
+    // wake asked for while S0 -> S0i1 was still in flight), so the machine
+    // is not where we want it. ask again
+    MachineInfo_t machineInfo = Machine_GetInfo(machine);
+    refreshMachine(machineInfo);
+    markDirty(machine);
+    if (machineInfo.s_state != pendingMachineStates[machine]) {
+        transitioning[machine] = true;
+        Machine_SetState(machine, pendingMachineStates[machine]);
+        return;
+    }
+    transitioning[machine] = false;
+    if (machineInfo.s_state == S0 && wakeFrom[machine] != S0) {
+        // the whole class is assumed to wake alike
+        unsigned cls = cluster_table.ClassOf(machineRank[machine]);
+        Time_t latency = standby.ObserveWake(cls, wakeFrom[machine], now - wakeStart[machine]);
+        for (unsigned rank = cluster_table.ClassBegin(cls); rank < cluster_table.ClassEnd(cls); rank++) {
+            energy_model.SetWakeLatency(machines[rank], wakeFrom[machine], latency);
+        }
+        wakeFrom[machine] = S0;
+    }
+    setParked(machine, machineInfo.s_state == S5 && wakingTasks[machine].empty());
+    if (machineInfo.s_state == S0 && !wakingTasks[machine].empty()) {
+        dispatchWaking(machine, now);
+        drainQueue();
+    }
 }
 
 // Public interface below
@@ -314,7 +1718,6 @@ void MigrationDone(Time_t time, VMId_t vm_id) {
     // The function is called on to alert you that migration is complete
     SimOutput("MigrationDone(): Migration of VM " + to_string(vm_id) + " was completed at time " + to_string(time), 4);
     Scheduler.MigrationComplete(time, vm_id);
-    migrating = false;
 }
 
 void SchedulerCheck(Time_t time) {
@@ -337,6 +1740,20 @@ void SimulationComplete(Time_t time) {
     cout << "SLA2: " << GetSLAReport(SLA2) << "%" << endl;     // SLA3 do not have SLA violation issues
     cout << "Total Energy " << Machine_GetClusterEnergy() << "KW-Hour" << endl;
     cout << "Simulation run finished in " << double(time)/1000000 << " seconds" << endl;
+    if (task_report_enabled && task_report.Write(TASK_REPORT_PATH)) {
+        cout << "Task report written to " << TASK_REPORT_PATH << ".csv/.json" << endl;
+    }
+    if (migrations.Completed() > 0) {
+        cout << "Migrations: " << migrations.Completed() << " done, " << migrations.MeanLatency() << " sec mean, "
+             << migrations.MaxLatency() << " sec max, " << migrations.MeanError() << " sec off the estimate" << endl;
+    }
+    if (power_cap_enabled) {
+        cout << "Power cap " << POWER_CAP_WATTS << "W: peak estimate " << peak_power << "W, " << double(time_over_cap)/1000000 << " sec over, "
+             << double(time_capped)/1000000 << " sec capped, " << warnings_capped << " SLA warnings while capped" << endl;
+    }
+    if (timeline_enabled && timeline.Write(TIMELINE_PATH)) {
+        cout << "Timeline written to " << TIMELINE_PATH << endl;
+    }
     SimOutput("SimulationComplete(): Simulation finished at time " + to_string(time), 4);
     
     Scheduler.Shutdown(time);
@@ -345,8 +1762,15 @@ void SimulationComplete(Time_t time) {
 void SLAWarning(Time_t time, TaskId_t task_id) {
     // cout << "SLA WARN AT " << time << " FOR TASK " << task_id << endl; 
     sla_violations += 1;
+    warnings_this_check += 1;
+    if (throttled_machines > 0 || sla3_held) {
+        warnings_capped += 1;
+    }
+    // capped so a burst of warnings can still relax away
+    oversub_margin = min(oversub_margin * OVERSUB_BACKOFF, OVERSUB_MARGIN * 16);
 }
 
 void StateChangeComplete(Time_t time, MachineId_t machine_id) {
     // Called in response to an earlier request to change the state of a machine
+    Scheduler.StateChangeComplete(time, machine_id);
 }
@@ -8,10 +8,39 @@
 #ifndef Scheduler_hpp
 #define Scheduler_hpp
 
+#include <set>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 
 #include "Interfaces.h"
+#include "ClusterTable.hpp"
+#include "Planner.hpp"
+
+struct TaskPriorityComparator {
+    bool operator()(TaskId_t a, TaskId_t b) {
+        SLAType_t aReqSLA = RequiredSLA(a);
+        SLAType_t bReqSLA = RequiredSLA(b);
+        Time_t aTargetCompletion = GetTaskInfo(a).target_completion;
+        Time_t bTargetCompletion = GetTaskInfo(b).target_completion;
+
+        // first, we prioritize the SLA 
+        // SLA0 highest priority, SLA3 is lowest
+        if (aReqSLA != bReqSLA) {
+            return aReqSLA < bReqSLA;
+        }
+
+        // if equal SLA, do the one that needs to be done first
+        return aTargetCompletion > bTargetCompletion;
+    }
+};
+
+typedef struct {
+    VMId_t vm;
+    VMType_t vm_type;
+    SLAType_t sla;                  // of the tasks in it, they are never mixed
+    unsigned tasks;
+} HostedVM_t;
 
 class Scheduler {
 public:
@@ -19,14 +48,96 @@ public:
     void Init();
     void MigrationComplete(Time_t time, VMId_t vm_id);
     void handleQueue();
+    void placeTask(TaskId_t task_id, MachineId_t machine, Time_t now);
+    void releaseDeferred(Time_t now);
+    void fillMachine(MachineId_t machine, Time_t now);
+    bool lookaheadPick(TaskId_t task_id, Time_t now, Pool_t pool, MachineId_t & best);
+    bool pickMachine(TaskId_t task_id, Time_t now, Pool_t pool, MachineId_t & machine);
     void NewTask(Time_t now, TaskId_t task_id);
     void PeriodicCheck(Time_t now);
     void Shutdown(Time_t now);
     void TaskComplete(Time_t now, TaskId_t task_id);
+    void StateChangeComplete(Time_t now, MachineId_t machine);
 private:
-    vector<VMId_t> vms;
+    // the live VMs on each machine, and which one each task runs in. with
+    // VM packing, several tasks can share a VM
+    vector<vector<HostedVM_t>> machineVMs;          // indexed by machine id
+    unordered_map<TaskId_t, VMId_t> taskVM;
+    bool joinVM(TaskId_t task_id, const MachineInfo_t & machineInfo, Time_t now, VMId_t & vm);
+    void releaseVM(TaskId_t task_id, MachineId_t machine);
+    // moving VMs off the least efficient machines so they can sleep
+    bool drainMachine(MachineId_t source, Time_t now);
+    void planMigrations(Time_t now);
+
+    // power cap: slowing the slackest machines down, holding SLA3 back
+    int64_t throttleSlack(MachineId_t machine, CPUPerformance_t p_state, Time_t now);
+    void enforcePowerCap(Time_t now);
+
+    // standby tiers: which idle machines stay shallow, and topping them up
+    unsigned idleAtOrAbove(unsigned cls, MachineState_t tier);
+    void planStandby(ClusterSnapshot_t & snapshot);
+
+    // capacity plan: wakes ahead of it and holds its machines up
+    void followPlan(Time_t now, ClusterSnapshot_t & snapshot);
+
     vector<MachineId_t> machines;
-    unordered_map<MachineId_t, MachineState_t> pendingMachineStates;
+    vector<MachineState_t> pendingMachineStates;      // indexed by machine id
+
+    // lightweight projection of each machine's occupancy (for lookahead)
+    vector<vector<TaskId_t>> residentTasks;         // indexed by machine id
+    vector<Time_t> projectedDrain;                  // when the machine is expected to go idle
+    unordered_map<TaskId_t, MachineId_t> taskMachine;
+    unordered_map<TaskId_t, Time_t> projectedFinish;
+    void trackPlacement(TaskId_t task_id, MachineId_t machine, Time_t finish);
+    void untrackTask(TaskId_t task_id);
+
+    // per-core DVFS: tasks grouped onto cores by slack
+    vector<vector<CPUPerformance_t>> corePStates;   // indexed by machine id, then core
+    unordered_map<TaskId_t, unsigned> taskCore;
+    void assignCores(MachineId_t machine, Time_t now);
+
+    // short/long segregation
+    unordered_set<TaskId_t> longTasks;
+    vector<bool> longPool;                          // indexed by machine id
+    vector<unsigned> longResidents;                 // long tasks on each machine
+    bool inPool(MachineId_t machine, Pool_t pool);
+
+    // SLA3 tasks held back until they can ride along on awake machines
+    vector<TaskId_t> deferredTasks;                 // in arrival order
+
+    // in-flight S-state transitions. tasks that need a machine to wake up
+    // wait on it here and are dispatched as soon as it reaches S0
+    vector<bool> transitioning;                     // indexed by machine id
+    vector<vector<TaskId_t>> wakingTasks;           // indexed by machine id
+    vector<unsigned> reservedMemory;                // memory + VM overhead held for wakingTasks
+    vector<Time_t> wakeStart;                       // when the last state request went out
+    vector<MachineState_t> wakeFrom;                // S-state a timed wake left, S0 if not timed
+    void requestState(MachineId_t machine, MachineState_t state);
+    MachineInfo_t reservedInfo(MachineId_t machine);
+    void dispatchWaking(MachineId_t machine, Time_t now);
+    void drainQueue();
+    void dispatchBatch(Time_t now);
+
+    // dirty sets: a check only looks at machines touched since the last one.
+    // machines settled at S5 are parked, which keeps them out of the power
+    // planner's walk and the deferred lane's search
+    vector<unsigned> machineRank;                   // position in machines, by id
+    vector<bool> dirty;                             // indexed by machine id
+    vector<MachineId_t> dirtyMachines;
+    set<unsigned> unparked;                         // ranks
+    set<unsigned> parked;                           // ranks, settled at S5
+    unsigned sweepCursor = 0;
+    void markDirty(MachineId_t machine);
+    void setParked(MachineId_t machine, bool isParked);
+    vector<MachineId_t> machinesToCheck(bool all);
+
+    // pushes a machine's current state into the cluster table
+    void refreshMachine(MachineId_t machine);
+    void refreshMachine(const MachineInfo_t & machineInfo);
+    unsigned admissibleLoad(const MachineInfo_t & machineInfo, Time_t now);
+
+    // validates a power plan against the live state and issues what's left
+    void applyPowerPlan(const PowerPlan_t & plan);
 };
 
 
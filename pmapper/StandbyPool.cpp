@@ -0,0 +1,66 @@
+//
+//  StandbyPool.cpp
+//  CloudSim
+//
+
+#include "StandbyPool.hpp"
+
+// weight of the newest tick in the smoothed arrival rate
+static const double RATE_SMOOTHING = 0.2;
+
+void StandbyPool::Init(unsigned num_classes, Time_t wait_target) {
+    this->wait_target = wait_target;
+    demand.assign(num_classes, 0);
+    rate.assign(num_classes, 0);
+    wake_mean.assign(num_classes, vector<double>(S_STATES, 0));
+    wake_count.assign(num_classes, vector<unsigned>(S_STATES, 0));
+}
+
+Time_t StandbyPool::ObserveWake(unsigned cls, MachineState_t from, Time_t latency) {
+    unsigned & count = wake_count[cls][from];
+    double & mean = wake_mean[cls][from];
+    count++;
+    mean += ((double)latency - mean) / count;
+    return (Time_t)mean;
+}
+
+void StandbyPool::Tick(Time_t now) {
+    if (now > last_tick && last_tick > 0) {
+        double seconds = (double)(now - last_tick) / 1000000.0;
+        for (unsigned cls = 0; cls < rate.size(); cls++) {
+            rate[cls] += RATE_SMOOTHING * (demand[cls] / seconds - rate[cls]);
+        }
+    }
+    demand.assign(demand.size(), 0);
+    last_tick = now;
+}
+
+// probability an arrival has to wait with c servers offered a erlangs,
+// from the Erlang B recurrence
+static double erlangC(unsigned servers, double load) {
+    double blocking = 1;
+    for (unsigned k = 1; k <= servers; k++) {
+        blocking = load * blocking / (k + load * blocking);
+    }
+    double utilization = load / servers;
+    return blocking / (1 - utilization * (1 - blocking));
+}
+
+unsigned StandbyPool::TierSize(unsigned cls, Time_t replenish, unsigned available) const {
+    if (rate[cls] <= 0 || replenish == 0) {
+        return 0;
+    }
+    double service = (double)replenish / 1000000.0;
+    double load = rate[cls] * service;
+    double target = (double)wait_target / 1000000.0;
+    for (unsigned servers = 1; servers <= available; servers++) {
+        if (servers <= load) {
+            continue;               // can't keep up at all
+        }
+        // mean wait in queue: C(c, a) / (c mu - lambda)
+        if (erlangC(servers, load) * service / (servers - load) <= target) {
+            return servers;
+        }
+    }
+    return available;
+}
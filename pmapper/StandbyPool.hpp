@@ -0,0 +1,49 @@
+//
+//  StandbyPool.hpp
+//  CloudSim
+//
+//  Sizes the tiers of idle machines kept in shallow sleep, per machine
+//  class. Each class's demand for fresh hosts (tasks landing on a machine
+//  with nothing on it) is tracked as an arrival rate, and a tier is sized
+//  as an M/M/c queue (Erlang C): a standby host that gets taken is
+//  replaced from the tier below it, which takes that tier's wake latency,
+//  and the tier needs enough hosts that the expected wait for one stays
+//  under the target. Wake latencies are measured per class and source
+//  S-state as machines come back up.
+//
+
+#ifndef StandbyPool_hpp
+#define StandbyPool_hpp
+
+#include <vector>
+
+#include "Interfaces.h"
+
+class StandbyPool {
+public:
+    StandbyPool()               {}
+    void Init(unsigned num_classes, Time_t wait_target);
+
+    // a machine of the class took latency to get from `from` back to S0.
+    // returns the class's running mean for that state
+    Time_t ObserveWake(unsigned cls, MachineState_t from, Time_t latency);
+    // a task went to a machine of the class that had nothing on it
+    void ObserveDemand(unsigned cls)                { demand[cls]++; }
+    // folds the demand since the last tick into the arrival rates
+    void Tick(Time_t now);
+
+    // hosts to keep in a tier refilled from a tier replenish away, out of
+    // at most available
+    unsigned TierSize(unsigned cls, Time_t replenish, unsigned available) const;
+    double Rate(unsigned cls) const                 { return rate[cls]; }
+
+private:
+    Time_t wait_target = 0;
+    Time_t last_tick = 0;
+    vector<unsigned> demand;                        // since the last tick
+    vector<double> rate;                            // per second, smoothed
+    vector<vector<double>> wake_mean;               // by class, then S-state
+    vector<vector<unsigned>> wake_count;
+};
+
+#endif /* StandbyPool_hpp */
@@ -0,0 +1,144 @@
+//
+//  TaskReport.cpp
+//  CloudSim
+//
+
+#include "TaskReport.hpp"
+#include "WorkloadCache.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+
+static const char * SLA_NAMES[] = {"SLA0", "SLA1", "SLA2", "SLA3"};
+static const char * CLASS_NAMES[] = {"AI_TRAINING", "CRYPTO", "SCIENTIFIC", "STREAMING", "WEB_REQUEST"};
+static const char * CPU_NAMES[] = {"ARM", "POWER", "RISCV", "X86"};
+
+void TaskReport::Arrive(TaskId_t task_id, Time_t now) {
+    if (task_id >= outcomes.size()) {
+        outcomes.resize(task_id + 1);
+        seen.resize(task_id + 1, false);
+    }
+    TaskInfo_t taskInfo = GetTaskInfo(task_id);
+    outcomes[task_id] = {now, 0, 0, taskInfo.target_completion, taskInfo.required_sla, GetTaskClass(task_id), taskInfo.required_cpu, false, false};
+    seen[task_id] = true;
+}
+
+// only the first dispatch counts, that is where the queueing delay ends
+void TaskReport::Dispatch(TaskId_t task_id, Time_t now) {
+    if (task_id < outcomes.size() && seen[task_id] && !outcomes[task_id].dispatched) {
+        outcomes[task_id].dispatch = now;
+        outcomes[task_id].dispatched = true;
+    }
+}
+
+void TaskReport::Complete(TaskId_t task_id, Time_t now) {
+    if (task_id < outcomes.size() && seen[task_id]) {
+        outcomes[task_id].completion = now;
+        outcomes[task_id].completed = true;
+    }
+}
+
+// nearest-rank percentile of an already sorted sample
+static double percentile(const vector<double> & sorted, double p) {
+    size_t rank = (size_t)(p * sorted.size() + 0.999999);
+    return sorted[min(sorted.size(), max((size_t)1, rank)) - 1];
+}
+
+// {"min":..,"p50":..,"p90":..,"p99":..,"max":..}, in ms. min is the tail
+// that matters for slack
+static void writeDistribution(FILE * out, vector<double> & sample) {
+    if (sample.empty()) {
+        fprintf(out, "null");
+        return;
+    }
+    sort(sample.begin(), sample.end());
+    fprintf(out, "{\"min\":%.3f,\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f,\"max\":%.3f}", sample.front(),
+            percentile(sample, 0.50), percentile(sample, 0.90), percentile(sample, 0.99), sample.back());
+}
+
+bool TaskReport::Write(const string & path) const {
+    FILE * csv = fopen((path + ".csv").c_str(), "w");
+    if (csv == nullptr) {
+        return false;
+    }
+    fprintf(csv, "task,sla,class,cpu,arrival,dispatch,completion,target,queue_delay,slack\n");
+
+    // per SLA, then per class, then per CPU type
+    typedef struct {
+        vector<double> queue_delay;
+        vector<double> slack;
+        unsigned tasks;
+        unsigned missed;
+        unsigned unfinished;
+    } Group_t;
+    vector<Group_t> groups(NUM_SLAS + 5 + 4, {{}, {}, 0, 0, 0});
+
+    for (TaskId_t task_id = 0; task_id < outcomes.size(); task_id++) {
+        if (!seen[task_id]) {
+            continue;
+        }
+        const Outcome_t & outcome = outcomes[task_id];
+        Group_t * rows[3] = {&groups[outcome.sla], &groups[NUM_SLAS + outcome.task_class], &groups[NUM_SLAS + 5 + outcome.cpu]};
+
+        int64_t queueDelay = outcome.dispatched ? (int64_t)(outcome.dispatch - outcome.arrival) : -1;
+        int64_t slack = outcome.completed ? (int64_t)outcome.target - (int64_t)outcome.completion : 0;
+        fprintf(csv, "%u,%s,%s,%s,%" PRIu64 ",", task_id, SLA_NAMES[outcome.sla], CLASS_NAMES[outcome.task_class], CPU_NAMES[outcome.cpu], outcome.arrival);
+        if (outcome.dispatched) {
+            fprintf(csv, "%" PRIu64 ",", outcome.dispatch);
+        } else {
+            fprintf(csv, ",");
+        }
+        if (outcome.completed) {
+            fprintf(csv, "%" PRIu64 ",%" PRIu64 ",%" PRId64 ",%" PRId64 "\n", outcome.completion, outcome.target, queueDelay, slack);
+        } else {
+            fprintf(csv, ",%" PRIu64 ",%s,\n", outcome.target, outcome.dispatched ? to_string(queueDelay).c_str() : "");
+        }
+
+        for (Group_t * group : rows) {
+            group->tasks++;
+            if (outcome.dispatched) {
+                group->queue_delay.push_back(queueDelay / 1000.0);
+            }
+            if (outcome.completed) {
+                group->slack.push_back(slack / 1000.0);
+                group->missed += slack < 0;
+            } else {
+                group->unfinished++;
+            }
+        }
+    }
+    bool ok = fclose(csv) == 0;
+
+    FILE * json = fopen((path + ".json").c_str(), "w");
+    if (json == nullptr) {
+        return false;
+    }
+    const char * sections[] = {"sla", "class", "cpu"};
+    const char ** names[] = {SLA_NAMES, CLASS_NAMES, CPU_NAMES};
+    unsigned sizes[] = {NUM_SLAS, 5, 4};
+    unsigned first = 0;
+
+    fprintf(json, "{\"units\":\"ms\"");
+    for (unsigned s = 0; s < 3; s++) {
+        fprintf(json, ",\n\"%s\":{", sections[s]);
+        bool any = false;
+        for (unsigned g = 0; g < sizes[s]; g++) {
+            Group_t & group = groups[first + g];
+            if (group.tasks == 0) {
+                continue;
+            }
+            fprintf(json, "%s\n  \"%s\":{\"tasks\":%u,\"missed\":%u,\"unfinished\":%u,\"queue_delay\":",
+                    any ? "," : "", names[s][g], group.tasks, group.missed, group.unfinished);
+            writeDistribution(json, group.queue_delay);
+            fprintf(json, ",\"slack\":");
+            writeDistribution(json, group.slack);
+            fprintf(json, "}");
+            any = true;
+        }
+        fprintf(json, "}");
+        first += sizes[s];
+    }
+    fprintf(json, "}\n");
+    return (fclose(json) == 0) && ok;
+}
@@ -0,0 +1,45 @@
+//
+//  TaskReport.hpp
+//  CloudSim
+//
+//  Per-task outcomes (arrival, dispatch, completion, target) and, at the
+//  end of the run, queueing-delay and completion-slack distributions per
+//  SLA, task class and CPU type.
+//
+
+#ifndef TaskReport_hpp
+#define TaskReport_hpp
+
+#include <string>
+#include <vector>
+
+#include "Interfaces.h"
+
+class TaskReport {
+public:
+    TaskReport()                {}
+    void Arrive(TaskId_t task_id, Time_t now);
+    void Dispatch(TaskId_t task_id, Time_t now);
+    void Complete(TaskId_t task_id, Time_t now);
+
+    // writes path.csv (one row per task) and path.json (the distributions)
+    bool Write(const string & path) const;
+
+private:
+    typedef struct {
+        Time_t arrival;
+        Time_t dispatch;
+        Time_t completion;
+        Time_t target;
+        SLAType_t sla;
+        TaskClass_t task_class;
+        CPUType_t cpu;
+        bool dispatched;
+        bool completed;
+    } Outcome_t;
+
+    vector<Outcome_t> outcomes;     // indexed by task id
+    vector<bool> seen;
+};
+
+#endif /* TaskReport_hpp */
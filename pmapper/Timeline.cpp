@@ -0,0 +1,148 @@
+//
+//  Timeline.cpp
+//  CloudSim
+//
+
+#include "Timeline.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+
+static const char * S_STATE_NAMES[S_STATES] = {"S0", "S0i1", "S1", "S2", "S3", "S4", "S5"};
+
+void Timeline::Init(unsigned machines, unsigned slots, size_t max_bytes, bool downsampling) {
+    num_machines = machines;
+    size_t perSample = sizeof(uint64_t) * max(1u, machines);
+    capacity = (unsigned)min((size_t)slots, max_bytes / perSample);
+    capacity = max(2u, capacity & ~1u);     // even, so halving keeps the stride aligned
+    downsample = downsampling;
+    stride = 1;
+    checks = 0;
+    head = 0;
+    count = 0;
+
+    time.assign(capacity, 0);
+    for (auto & column : s_states) {
+        column.assign(capacity, 0);
+    }
+    for (auto & column : p_states) {
+        column.assign(capacity, 0);
+    }
+    memory_util.assign(capacity, 0);
+    core_util.assign(capacity, 0);
+    energy.reset(new uint64_t[(size_t)capacity * num_machines]);
+}
+
+bool Timeline::Begin(Time_t now) {
+    if (capacity == 0 || checks++ % stride != 0) {
+        return false;
+    }
+    time[head] = now;
+    fill(begin(cur_s), end(cur_s), 0);
+    fill(begin(cur_p), end(cur_p), 0);
+    mem_used = mem_total = tasks = cores = 0;
+    return true;
+}
+
+void Timeline::Add(const MachineInfo_t & machineInfo) {
+    cur_s[machineInfo.s_state]++;
+    if (machineInfo.s_state == S0) {
+        cur_p[machineInfo.p_state]++;
+    }
+    mem_used += machineInfo.memory_used;
+    mem_total += machineInfo.memory_size;
+    tasks += min(machineInfo.active_tasks, machineInfo.num_cpus);
+    cores += machineInfo.num_cpus;
+    if (machineInfo.machine_id < num_machines) {
+        energy[(size_t)head * num_machines + machineInfo.machine_id] = machineInfo.energy_consumed;
+    }
+}
+
+void Timeline::End() {
+    for (unsigned s = 0; s < S_STATES; s++) {
+        s_states[s][head] = cur_s[s];
+    }
+    for (unsigned p = 0; p < P_STATES; p++) {
+        p_states[p][head] = cur_p[p];
+    }
+    memory_util[head] = mem_total ? (float)mem_used / mem_total : 0;
+    core_util[head] = cores ? (float)tasks / cores : 0;
+
+    if (downsample) {
+        head++;
+        count++;
+        if (count == capacity) {
+            compact();
+        }
+    } else {
+        head = (head + 1) % capacity;
+        count = min(count + 1, capacity);
+    }
+}
+
+// keeps every other sample and halves the sampling rate from here on
+void Timeline::compact() {
+    unsigned kept = 0;
+    for (unsigned slot = 0; slot < count; slot += 2, kept++) {
+        time[kept] = time[slot];
+        for (auto & column : s_states) {
+            column[kept] = column[slot];
+        }
+        for (auto & column : p_states) {
+            column[kept] = column[slot];
+        }
+        memory_util[kept] = memory_util[slot];
+        core_util[kept] = core_util[slot];
+        copy_n(energy.get() + (size_t)slot * num_machines, num_machines, energy.get() + (size_t)kept * num_machines);
+    }
+    count = kept;
+    head = kept;
+    stride *= 2;
+}
+
+bool Timeline::Write(const string & path) const {
+    FILE * out = fopen(path.c_str(), "w");
+    if (out == nullptr) {
+        return false;
+    }
+
+    fprintf(out, "time");
+    for (auto name : S_STATE_NAMES) {
+        fprintf(out, ",%s", name);
+    }
+    for (unsigned p = 0; p < P_STATES; p++) {
+        fprintf(out, ",P%u", p);
+    }
+    fprintf(out, ",memory_util,core_util,energy_kwh");
+    for (unsigned m = 0; m < num_machines; m++) {
+        fprintf(out, ",m%u_j", m);
+    }
+    fprintf(out, "\n");
+
+    // a wrapped ring starts at head
+    unsigned start = (!downsample && count == capacity) ? head : 0;
+    for (unsigned i = 0; i < count; i++) {
+        unsigned slot = (start + i) % capacity;
+        fprintf(out, "%" PRIu64, time[slot]);
+        for (auto & column : s_states) {
+            fprintf(out, ",%u", column[slot]);
+        }
+        for (auto & column : p_states) {
+            fprintf(out, ",%u", column[slot]);
+        }
+
+        // energy is in W*us
+        const uint64_t * machines = &energy[(size_t)slot * num_machines];
+        double total = 0;
+        for (unsigned m = 0; m < num_machines; m++) {
+            total += machines[m];
+        }
+        fprintf(out, ",%.4f,%.4f,%.6f", memory_util[slot], core_util[slot], total / 3.6e12);
+        for (unsigned m = 0; m < num_machines; m++) {
+            fprintf(out, ",%.1f", machines[m] / 1e6);
+        }
+        fprintf(out, "\n");
+    }
+    return fclose(out) == 0;
+}
@@ -0,0 +1,64 @@
+//
+//  Timeline.hpp
+//  CloudSim
+//
+//  Cluster time series sampled at SchedulerCheck: machines per S-state,
+//  awake machines per P-state, memory and core utilization, and every
+//  machine's cumulative energy. Samples go into preallocated columns used
+//  as a ring; in downsampling mode a full ring instead drops every other
+//  sample and halves the sampling rate, so the whole run stays covered.
+//
+
+#ifndef Timeline_hpp
+#define Timeline_hpp
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Interfaces.h"
+
+class Timeline {
+public:
+    Timeline()                  {}
+    // capacity is in samples, and is cut down for large clusters so the
+    // per-machine energy columns stay within max_bytes
+    void Init(unsigned num_machines, unsigned capacity, size_t max_bytes, bool downsample);
+
+    // one sample is a Begin, an Add per machine, then an End. checks that
+    // fall between samples (after downsampling) are skipped at Begin
+    bool Begin(Time_t now);
+    void Add(const MachineInfo_t & machineInfo);
+    void End();
+
+    // time series as CSV, oldest sample first
+    bool Write(const string & path) const;
+
+private:
+    unsigned num_machines = 0;
+    unsigned capacity = 0;
+    bool downsample = false;
+    unsigned stride = 1;                // sample every stride-th check
+    uint64_t checks = 0;
+    unsigned head = 0;                  // next slot to write
+    unsigned count = 0;
+
+    // one entry per slot
+    vector<Time_t> time;
+    vector<uint32_t> s_states[S_STATES];
+    vector<uint32_t> p_states[P_STATES];    // awake machines only
+    vector<float> memory_util;
+    vector<float> core_util;
+    // slot * num_machines + machine. left uninitialized: a sample writes its
+    // whole row, so pages are only touched as samples land
+    unique_ptr<uint64_t[]> energy;
+
+    // running totals for the sample being taken
+    uint32_t cur_s[S_STATES];
+    uint32_t cur_p[P_STATES];
+    uint64_t mem_used, mem_total, tasks, cores;
+
+    void compact();
+};
+
+#endif /* Timeline_hpp */
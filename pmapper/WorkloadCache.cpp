@@ -0,0 +1,260 @@
+//
+//  WorkloadCache.cpp
+//  CloudSim
+//
+//  Fast workload loading. The first run of an input file expands it through
+//  the reference text loader (Init.o, renamed to InitText by the Makefile)
+//  and records every Machine_Add/AddTask call into a versioned binary image.
+//  Later runs mmap that image and replay it directly.
+//
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Interfaces.h"
+#include "Internal_Interfaces.h"
+#include "WorkloadCache.hpp"
+
+static bool workload_cache_enabled = true;
+
+#define IMAGE_MAGIC     0x474d494c4b524f57ULL  // "WORKLIMG"
+#define IMAGE_VERSION   1
+
+// the reference loader, with its Init/AddTask/Machine_Add/InitScheduler
+// symbols redirected to the functions below (see InitText.o in the Makefile)
+extern void InitText(string filename);
+
+typedef struct {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t num_machines;
+    uint64_t key;
+    uint32_t num_tasks;
+    uint32_t machine_words;     // size of the machine section in uint32_t's
+} ImageHeader_t;
+
+typedef struct {
+    uint64_t inst;
+    uint64_t arrival;
+    uint64_t target;
+    uint32_t vm;
+    uint32_t sla;
+    uint32_t cpu;
+    uint32_t gpu;
+    uint32_t memory;
+    uint32_t task_class;
+} TaskRecord_t;
+
+// a machine is stored as memory, cores, gpu, cpu, then each of the s/c/p/mips
+// tables as a length followed by its values
+static vector<uint32_t> recorded_machines;
+static vector<TaskRecord_t> recorded_tasks;
+static unsigned recorded_machine_count = 0;
+static bool recording = false;
+static string image_path;
+static uint64_t image_key = 0;
+static vector<TaskClass_t> task_classes;       // indexed by task id
+
+static TaskId_t addTask(uint64_t inst, Time_t arr, Time_t trgt, VMType_t vm, SLAType_t sla, CPUType_t cpu, bool gpu, unsigned mem, TaskClass_t task_class) {
+    TaskId_t task_id = AddTask(inst, arr, trgt, vm, sla, cpu, gpu, mem, task_class);
+    if (task_id >= task_classes.size()) {
+        task_classes.resize(task_id + 1, WEB_REQUEST);
+    }
+    task_classes[task_id] = task_class;
+    return task_id;
+}
+
+TaskClass_t GetTaskClass(TaskId_t task_id) {
+    return task_id < task_classes.size() ? task_classes[task_id] : WEB_REQUEST;
+}
+
+class MappedFile {
+public:
+    MappedFile(const string & path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void * addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr != MAP_FAILED) {
+                data = (const char *)addr;
+                size = st.st_size;
+            }
+        }
+        close(fd);
+    }
+    ~MappedFile() {
+        if (data != nullptr) {
+            munmap((void *)data, size);
+        }
+    }
+    const char * data = nullptr;
+    size_t size = 0;
+};
+
+static uint64_t fnv1a(uint64_t hash, const char * data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// key for an input file: hash of its bytes, with every task class seed folded
+// in on top. the seeds are pulled straight out of the mapped buffer
+static uint64_t workloadKey(const MappedFile & input) {
+    uint64_t hash = fnv1a(0xcbf29ce484222325ULL, input.data, input.size);
+
+    const char * end = input.data + input.size;
+    const char * cursor = input.data;
+    while ((cursor = (const char *)memmem(cursor, end - cursor, "Seed", 4)) != nullptr) {
+        cursor += 4;
+        while (cursor < end && (*cursor == ' ' || *cursor == ':' || *cursor == '\t')) {
+            cursor++;
+        }
+        uint64_t seed = 0;
+        while (cursor < end && *cursor >= '0' && *cursor <= '9') {
+            seed = seed * 10 + (*cursor++ - '0');
+        }
+        hash = fnv1a(hash, (const char *)&seed, sizeof(seed));
+    }
+    return fnv1a(hash, (const char *)&input.size, sizeof(input.size));
+}
+
+static void recordTable(const vector<u_int> & table) {
+    recorded_machines.push_back(table.size());
+    recorded_machines.insert(recorded_machines.end(), table.begin(), table.end());
+}
+
+void RecordMachineAdd(u_int mem, u_int cores, vector<u_int> & s_states, vector<u_int> & c_states, vector<u_int> & p_states, vector<u_int> & mips, bool gpu, CPUType_t cpu) {
+    if (recording) {
+        recorded_machines.insert(recorded_machines.end(), {mem, cores, gpu, (uint32_t)cpu});
+        recordTable(s_states);
+        recordTable(c_states);
+        recordTable(p_states);
+        recordTable(mips);
+        recorded_machine_count++;
+    }
+    Machine_Add(mem, cores, s_states, c_states, p_states, mips, gpu, cpu);
+}
+
+TaskId_t RecordAddTask(uint64_t inst, Time_t arr, Time_t trgt, VMType_t vm, SLAType_t sla, CPUType_t cpu, bool gpu, unsigned mem, TaskClass_t task_class) {
+    if (recording) {
+        recorded_tasks.push_back({inst, arr, trgt, vm, sla, cpu, gpu, mem, task_class});
+    }
+    return addTask(inst, arr, trgt, vm, sla, cpu, gpu, mem, task_class);
+}
+
+// called by the reference loader once the input is fully expanded, right
+// before the simulation starts
+void RecordInitScheduler() {
+    if (recording) {
+        recording = false;
+
+        ImageHeader_t header = {IMAGE_MAGIC, IMAGE_VERSION, recorded_machine_count, image_key, (uint32_t)recorded_tasks.size(), (uint32_t)recorded_machines.size()};
+        string tmp_path = image_path + ".tmp";
+        FILE * image = fopen(tmp_path.c_str(), "wb");
+        if (image != nullptr) {
+            bool ok = fwrite(&header, sizeof(header), 1, image) == 1;
+            ok = ok && fwrite(recorded_machines.data(), sizeof(uint32_t), recorded_machines.size(), image) == recorded_machines.size();
+            ok = ok && fwrite(recorded_tasks.data(), sizeof(TaskRecord_t), recorded_tasks.size(), image) == recorded_tasks.size();
+            ok = (fclose(image) == 0) && ok;
+            if (ok) {
+                rename(tmp_path.c_str(), image_path.c_str());
+                SimOutput("RecordInitScheduler(): Wrote workload image " + image_path, 1);
+            } else {
+                remove(tmp_path.c_str());
+            }
+        }
+        recorded_machines = vector<uint32_t>();
+        recorded_tasks = vector<TaskRecord_t>();
+    }
+    InitScheduler();
+}
+
+// replays a mapped image. returns false (having added nothing) if the image
+// is stale, from another version, or truncated
+static bool replayImage(const MappedFile & image, uint64_t key) {
+    if (image.data == nullptr || image.size < sizeof(ImageHeader_t)) {
+        return false;
+    }
+    ImageHeader_t header;
+    memcpy(&header, image.data, sizeof(header));
+    if (header.magic != IMAGE_MAGIC || header.version != IMAGE_VERSION || header.key != key) {
+        return false;
+    }
+    size_t expected = sizeof(header) + header.machine_words * sizeof(uint32_t) + (size_t)header.num_tasks * sizeof(TaskRecord_t);
+    if (image.size != expected) {
+        return false;
+    }
+
+    const uint32_t * words = (const uint32_t *)(image.data + sizeof(header));
+    const uint32_t * words_end = words + header.machine_words;
+    for (unsigned m = 0; m < header.num_machines; m++) {
+        if (words + 4 > words_end) {
+            ThrowException("Init(): Corrupt workload image ", image_path);
+        }
+        u_int mem = words[0], cores = words[1];
+        bool gpu = words[2] != 0;
+        CPUType_t cpu = CPUType_t(words[3]);
+        words += 4;
+
+        vector<u_int> tables[4];
+        for (auto & table : tables) {
+            if (words >= words_end || words + 1 + *words > words_end) {
+                ThrowException("Init(): Corrupt workload image ", image_path);
+            }
+            table.assign(words + 1, words + 1 + *words);
+            words += 1 + *words;
+        }
+        Machine_Add(mem, cores, tables[0], tables[1], tables[2], tables[3], gpu, cpu);
+    }
+
+    const TaskRecord_t * tasks = (const TaskRecord_t *)words_end;
+    for (unsigned t = 0; t < header.num_tasks; t++) {
+        const TaskRecord_t & task = tasks[t];
+        addTask(task.inst, task.arrival, task.target, VMType_t(task.vm), SLAType_t(task.sla), CPUType_t(task.cpu), task.gpu != 0, task.memory, TaskClass_t(task.task_class));
+    }
+    return true;
+}
+
+void Init(string filename) {
+    if (!workload_cache_enabled) {
+        InitText(filename);
+        return;
+    }
+
+    {
+        MappedFile input(filename);
+        if (input.data == nullptr) {
+            ThrowException("Init(): Could not input file ", filename);
+        }
+        image_key = workloadKey(input);
+    }
+    image_path = filename + ".img";
+
+    bool replayed;
+    {
+        MappedFile image(image_path);
+        replayed = replayImage(image, image_key);
+    }
+    if (!replayed) {
+        // no usable image, expand the text and record it on the way
+        recording = true;
+        InitText(filename);
+        return;
+    }
+
+    SimOutput("Init(): Loaded workload image " + image_path, 1);
+    SimOutput("Init(): Found " + to_string(GetNumTasks()) + " tasks", 1);
+    SimOutput("Init(): Found " + to_string(Machine_GetTotal()) + " machines", 1);
+    SimOutput("Init(): About to initialize scheduler", 1);
+    InitScheduler();
+    StartSimulation();
+}
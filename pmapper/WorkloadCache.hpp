@@ -0,0 +1,15 @@
+//
+//  WorkloadCache.hpp
+//  CloudSim
+//
+
+#ifndef WorkloadCache_hpp
+#define WorkloadCache_hpp
+
+#include "Interfaces.h"
+
+// the class a task was generated from. the simulator does not keep it, so
+// the loader records it for every task it adds
+extern TaskClass_t      GetTaskClass(TaskId_t task_id);
+
+#endif /* WorkloadCache_hpp */
@@ -0,0 +1,286 @@
+//
+//  CapPlan.cpp
+//  CloudSim
+//
+//  Offline capacity planner. Reads a workload file, whose task classes
+//  declare their start, end, inter-arrival, expected runtime and CPU type
+//  up front, and writes the capacity plan the scheduler follows when
+//  PMAPPER_PLAN names it (see CapacityPlan.hpp).
+//
+//  A task class is taken as Poisson arrivals with a fixed runtime, so the
+//  tasks it has running at t are Poisson with mean rate * (the part of
+//  [t - runtime, t] inside its window), and a CPU type's classes add up.
+//  Each bucket gets the slots that cover its peak mean at the quantile
+//  asked for, capped at what the CPU type has, and the fewest machines
+//  that give them, biggest first. Runtimes are scaled by -r, as the
+//  declared ones run long next to what the simulator measures.
+//
+//  usage: capplan [-q quantile] [-b bucket_us] [-c tasks_per_core]
+//                 [-r runtime_scale] [-o plan.txt] input.md
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "CapacityPlan.hpp"
+
+// what the scheduler attaches to each VM (VM_OVERHEAD)
+static const unsigned VM_MEMORY = 8;
+// a new step is written when the expected tasks drift this far
+static const double TASK_DRIFT = 0.1;
+
+typedef struct {
+    unsigned count;
+    CPUType_t cpu;
+    unsigned cores;
+    unsigned memory;
+} MachineSpec_t;
+
+typedef struct {
+    Time_t start;
+    Time_t end;
+    Time_t inter_arrival;
+    Time_t runtime;
+    unsigned memory;
+    CPUType_t cpu;
+} TaskSpec_t;
+
+typedef struct {
+    double quantile;
+    Time_t bucket;
+    double tasks_per_core;
+    double runtime_scale;
+    string output;
+    string input;
+} Options_t;
+
+static string trim(const string & text) {
+    size_t first = text.find_first_not_of(" \t\r\n");
+    if (first == string::npos) {
+        return "";
+    }
+    size_t last = text.find_last_not_of(" \t\r\n");
+    return text.substr(first, last - first + 1);
+}
+
+static bool parseCPU(const string & name, CPUType_t & cpu) {
+    static const char * NAMES[] = {"ARM", "POWER", "RISCV", "X86"};
+    for (unsigned c = 0; c < 4; c++) {
+        if (name == NAMES[c]) {
+            cpu = CPUType_t(c);
+            return true;
+        }
+    }
+    return false;
+}
+
+// machine and task classes as "key: value" lines inside braces. keys that
+// do not matter here are skipped
+static bool readWorkload(const string & path, vector<MachineSpec_t> & machines, vector<TaskSpec_t> & tasks) {
+    FILE * in = fopen(path.c_str(), "r");
+    if (in == nullptr) {
+        fprintf(stderr, "capplan: cannot open %s\n", path.c_str());
+        return false;
+    }
+    enum { NONE, MACHINE, TASK } block = NONE;
+    char buffer[1024];
+    unsigned line = 0;
+    bool ok = true;
+    while (ok && fgets(buffer, sizeof(buffer), in) != nullptr) {
+        line++;
+        string text = trim(buffer);
+        if (text == "machine class:") {
+            machines.push_back({0, X86, 0, 0});
+            block = MACHINE;
+            continue;
+        } else if (text == "task class:") {
+            tasks.push_back({0, 0, 1, 0, 0, X86});
+            block = TASK;
+            continue;
+        }
+        size_t colon = text.find(':');
+        if (block == NONE || colon == string::npos) {
+            continue;
+        }
+        string key = trim(text.substr(0, colon));
+        string value = trim(text.substr(colon + 1));
+        uint64_t number = strtoull(value.c_str(), nullptr, 10);
+        if (key == "CPU type") {
+            CPUType_t & cpu = block == MACHINE ? machines.back().cpu : tasks.back().cpu;
+            if (!parseCPU(value, cpu)) {
+                fprintf(stderr, "capplan: %s:%u: unknown CPU type %s\n", path.c_str(), line, value.c_str());
+                ok = false;
+            }
+        } else if (block == MACHINE) {
+            MachineSpec_t & machine = machines.back();
+            if (key == "Number of machines")    machine.count = number;
+            else if (key == "Number of cores")  machine.cores = number;
+            else if (key == "Memory")           machine.memory = number;
+        } else {
+            TaskSpec_t & task = tasks.back();
+            if (key == "Start time")            task.start = number;
+            else if (key == "End time")         task.end = number;
+            else if (key == "Inter arrival")    task.inter_arrival = max<uint64_t>(1, number);
+            else if (key == "Expected runtime") task.runtime = number;
+            else if (key == "Memory")           task.memory = number;
+        }
+    }
+    fclose(in);
+    return ok;
+}
+
+// mean tasks of the class running at t
+static double running(const TaskSpec_t & task, Time_t runtime, Time_t t) {
+    double from = max((double)task.start, (double)t - (double)runtime);
+    double to = min((double)task.end, (double)t);
+    return to > from ? (to - from) / (double)task.inter_arrival : 0;
+}
+
+// smallest k with P(X <= k) >= quantile for X ~ Poisson(mean). past a few
+// hundred the normal approximation is as good and the pmf underflows
+static unsigned poissonQuantile(double mean, double quantile) {
+    if (mean <= 0) {
+        return 0;
+    }
+    if (mean > 500) {
+        double low = -10, high = 10;
+        for (unsigned i = 0; i < 60; i++) {
+            double z = (low + high) / 2;
+            (0.5 * erfc(-z / sqrt(2.0)) < quantile ? low : high) = z;
+        }
+        return (unsigned)ceil(mean + high * sqrt(mean));
+    }
+    double pmf = exp(-mean);
+    double cdf = pmf;
+    unsigned k = 0;
+    while (cdf < quantile && k < 100000) {
+        k++;
+        pmf *= mean / k;
+        cdf += pmf;
+    }
+    return k;
+}
+
+static void usage() {
+    fprintf(stderr, "usage: capplan [-q quantile] [-b bucket_us] [-c tasks_per_core] [-r runtime_scale]\n"
+                    "               [-o plan.txt] input.md\n");
+    exit(2);
+}
+
+int main(int argc, char * argv[]) {
+    // tasks in the simulator finish well inside their expected runtime
+    Options_t options = {0.99, 1000000, 1.0, 0.5, "capacity.plan", ""};
+    int opt;
+    while ((opt = getopt(argc, argv, "q:b:c:r:o:")) != -1) {
+        switch (opt) {
+            case 'q': options.quantile = min(0.999999, max(0.5, atof(optarg))); break;
+            case 'b': options.bucket = max(1000ll, atoll(optarg)); break;
+            case 'c': options.tasks_per_core = max(0.1, atof(optarg)); break;
+            case 'r': options.runtime_scale = max(0.01, atof(optarg)); break;
+            case 'o': options.output = optarg; break;
+            default: usage();
+        }
+    }
+    if (optind != argc - 1) {
+        usage();
+    }
+    options.input = argv[optind];
+
+    vector<MachineSpec_t> machines;
+    vector<TaskSpec_t> tasks;
+    if (!readWorkload(options.input, machines, tasks)) {
+        return 1;
+    }
+
+    CapacityPlan plan;
+    for (unsigned c = 0; c < 4; c++) {
+        CPUType_t cpu = CPUType_t(c);
+        vector<const TaskSpec_t *> classes;
+        Time_t horizon = 0;
+        double memory = 0;
+        for (const TaskSpec_t & task : tasks) {
+            if (task.cpu == cpu) {
+                classes.push_back(&task);
+                horizon = max(horizon, task.end + (Time_t)(task.runtime * options.runtime_scale));
+                memory = max(memory, (double)task.memory);
+            }
+        }
+
+        // slots per machine, biggest first, for the fewest machines
+        vector<unsigned> sizes;
+        unsigned total = 0;
+        for (const MachineSpec_t & machine : machines) {
+            if (machine.cpu != cpu) {
+                continue;
+            }
+            unsigned slots = (unsigned)(machine.cores * options.tasks_per_core);
+            slots = min(slots, (unsigned)(machine.memory / (memory + VM_MEMORY)));
+            sizes.insert(sizes.end(), machine.count, slots);
+            total += machine.count * slots;
+        }
+        sort(sizes.rbegin(), sizes.rend());
+        if (classes.empty() || sizes.empty()) {
+            continue;
+        }
+
+        // the mean is piecewise linear in t, so over a bucket it peaks at an
+        // end or where some class starts or stops ramping
+        vector<Time_t> corners;
+        for (const TaskSpec_t * task : classes) {
+            Time_t runtime = (Time_t)(task->runtime * options.runtime_scale);
+            corners.insert(corners.end(), {task->start, task->end, task->start + runtime, task->end + runtime});
+        }
+        sort(corners.begin(), corners.end());
+
+        unsigned lastSlots = UINT32_MAX;
+        double lastTasks = -1;
+        for (Time_t t0 = 0; t0 <= horizon; t0 += options.bucket) {
+            Time_t t1 = t0 + options.bucket;
+            vector<Time_t> points = {t0, t1};
+            for (auto it = upper_bound(corners.begin(), corners.end(), t0); it != corners.end() && *it < t1; it++) {
+                points.push_back(*it);
+            }
+            double peak = 0;
+            for (Time_t t : points) {
+                double mean = 0;
+                for (const TaskSpec_t * task : classes) {
+                    mean += running(*task, (Time_t)(task->runtime * options.runtime_scale), t);
+                }
+                peak = max(peak, mean);
+            }
+
+            unsigned slots = min(total, poissonQuantile(peak, options.quantile));
+            bool drifted = fabs(peak - lastTasks) > TASK_DRIFT * max(1.0, lastTasks);
+            if (slots == lastSlots && !drifted) {
+                continue;
+            }
+            unsigned count = 0;
+            for (unsigned covered = 0; covered < slots && count < sizes.size(); count++) {
+                covered += sizes[count];
+            }
+            plan.Add({t0, cpu, count, slots, peak});
+            lastSlots = slots;
+            lastTasks = peak;
+        }
+        // nothing left after the last class drains
+        if (lastSlots != 0) {
+            plan.Add({horizon + options.bucket, cpu, 0, 0, 0});
+        }
+    }
+
+    char comment[512];
+    snprintf(comment, sizeof(comment), "capacity plan for %s: quantile %g, %llu us buckets, %g tasks per core, runtime x%g",
+             options.input.c_str(), options.quantile, (unsigned long long)options.bucket, options.tasks_per_core, options.runtime_scale);
+    if (!plan.Write(options.output, comment)) {
+        fprintf(stderr, "capplan: cannot write %s\n", options.output.c_str());
+        return 1;
+    }
+    fprintf(stderr, "%u steps written to %s\n", plan.Steps(), options.output.c_str());
+    return 0;
+}
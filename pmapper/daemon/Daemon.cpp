@@ -0,0 +1,128 @@
+//
+//  Daemon.cpp
+//  CloudSim
+//
+//  pmapperd: the scheduler as a long-lived process. It creates the event
+//  channel (see EventRing.hpp) and waits for a cluster to drive it. Each
+//  event goes to the entry point the simulator would call, the actions the
+//  scheduler takes on the way go back as they happen, and an ACT_DONE
+//  closes the event so the cluster can time the decision. EV_SHUTDOWN runs
+//  SimulationComplete and ends the process.
+//
+//  The scheduler talks to the cluster through Interfaces.h as always; the
+//  daemon's side of that is Mirror.cpp. Its progress output goes to cout,
+//  which stays quiet unless -v is given.
+//
+//  usage: pmapperd [-u] [-c capacity] [-v level] name
+//
+//  name is the shared-memory segment, or with -u the socket path.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <unistd.h>
+
+#include "Mirror.hpp"
+
+static void usage() {
+    fprintf(stderr, "usage: pmapperd [-u] [-c capacity] [-v level] name\n");
+    exit(2);
+}
+
+int main(int argc, char * argv[]) {
+    bool socket = false;
+    unsigned capacity = 1 << 16;
+    unsigned verbose = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "uc:v:")) != -1) {
+        switch (opt) {
+            case 'u': socket = true; break;
+            case 'c': capacity = max(16, atoi(optarg)); break;
+            case 'v': verbose = atoi(optarg); break;
+            default: usage();
+        }
+    }
+    if (optind != argc - 1) {
+        usage();
+    }
+
+    EventChannel channel;
+    string error;
+    if (!channel.Create(argv[optind], socket, capacity, error)) {
+        fprintf(stderr, "pmapperd: %s\n", error.c_str());
+        return 1;
+    }
+    if (verbose == 0) {
+        cout.setstate(ios::badbit);
+    }
+    Mirror_Bind(&channel, verbose);
+
+    uint64_t handled = 0;
+    bool running = true;
+    Record_t event;
+    try {
+        while (running) {
+            if (!channel.Receive(event, true)) {
+                fprintf(stderr, "pmapperd: the cluster has gone away\n");
+                return 1;
+            }
+            Mirror_SetNow(event.time);
+            switch (event.type) {
+                case EV_MACHINE:
+                    Mirror_AddMachine(event);
+                    break;
+                case EV_START:
+                    InitScheduler();
+                    break;
+                case EV_TASK_ARRIVAL:
+                    HandleNewTask(event.time, Mirror_AddTask(event));
+                    break;
+                case EV_TASK_DONE:
+                    Mirror_FinishTask(event.id);
+                    HandleTaskCompletion(event.time, event.id);
+                    break;
+                case EV_STATE_DONE:
+                    Mirror_StateDone(event.id, MachineState_t(event.arg.a));
+                    StateChangeComplete(event.time, event.id);
+                    break;
+                case EV_MIGRATION_DONE:
+                    Mirror_MigrationDone(event.id);
+                    MigrationDone(event.time, event.id);
+                    break;
+                case EV_MEMORY_WARNING:
+                    MemoryWarning(event.time, event.id);
+                    break;
+                case EV_SLA_WARNING:
+                    SLAWarning(event.time, event.id);
+                    break;
+                case EV_CHECK:
+                    SchedulerCheck(event.time);
+                    break;
+                case EV_SHUTDOWN:
+                    SimulationComplete(event.time);
+                    running = false;
+                    break;
+                default:
+                    fprintf(stderr, "pmapperd: unknown event type %u\n", event.type);
+                    break;
+            }
+            Record_t done = {};
+            done.type = ACT_DONE;
+            done.id = event.type;
+            done.seq = event.seq;
+            done.time = event.time;
+            done.sent_ns = event.sent_ns;
+            if (!channel.Send(done)) {
+                fprintf(stderr, "pmapperd: the cluster has gone away\n");
+                return 1;
+            }
+            handled++;
+        }
+    } catch (const exception & e) {
+        fprintf(stderr, "pmapperd: %s\n", e.what());
+        return 1;
+    }
+    fprintf(stderr, "pmapperd: %llu events handled\n", (unsigned long long)handled);
+    return 0;
+}
@@ -0,0 +1,243 @@
+//
+//  EventRing.cpp
+//  CloudSim
+//
+
+#include "EventRing.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+static_assert(atomic<uint64_t>::is_always_lock_free, "the rings need lock-free 64-bit counters");
+static_assert(sizeof(Record_t) <= 128, "records are meant to fit two cache lines");
+
+static const uint64_t MAGIC = 0x706d61707065726eull;       // "pmappern"
+// how long Attach keeps trying while the daemon comes up
+static const unsigned ATTACH_TRIES = 500;
+static const long ATTACH_WAIT_NS = 10000000;
+
+// busy-wait first (unless the other end needs this core to make
+// progress), then give the core away, then sleep, so an idle end costs next
+// to nothing and a busy one never makes a system call
+static const unsigned SPIN_LIMIT = 20000;
+static const unsigned YIELD_LIMIT = SPIN_LIMIT + 2000;
+static const bool ALONE = sysconf(_SC_NPROCESSORS_ONLN) < 2;
+
+static void backoff(unsigned & spins) {
+    if (spins == 0 && ALONE) {
+        spins = SPIN_LIMIT;
+    }
+    spins++;
+    if (spins < SPIN_LIMIT) {
+        return;
+    }
+    if (spins < YIELD_LIMIT) {
+        sched_yield();
+        return;
+    }
+    struct timespec pause = {0, 20000};
+    nanosleep(&pause, nullptr);
+}
+
+static string shmName(const string & name) {
+    return name[0] == '/' ? name : "/" + name;
+}
+
+bool EventChannel::map(const string & name, bool create, unsigned capacity, string & error) {
+    string path = shmName(name);
+    fd = shm_open(path.c_str(), create ? O_RDWR | O_CREAT | O_TRUNC : O_RDWR, 0600);
+    if (fd < 0) {
+        error = "cannot open shared memory " + path + ": " + strerror(errno);
+        return false;
+    }
+    shm = true;
+    if (create) {
+        segment_size = sizeof(Segment_t) + 2 * (size_t)capacity * sizeof(Record_t);
+        if (ftruncate(fd, segment_size) != 0) {
+            error = "cannot size shared memory " + path + ": " + strerror(errno);
+            return false;
+        }
+        unlink_path = path;
+    } else {
+        // the header first, for the size of the rest
+        void * header = mmap(nullptr, sizeof(Segment_t), PROT_READ, MAP_SHARED, fd, 0);
+        if (header == MAP_FAILED) {
+            error = "cannot map " + path + ": " + strerror(errno);
+            return false;
+        }
+        const Segment_t * peek = (const Segment_t *)header;
+        bool ready = peek->magic == MAGIC && peek->record_size == sizeof(Record_t);
+        capacity = peek->capacity;
+        munmap(header, sizeof(Segment_t));
+        if (!ready) {
+            error = path + " is not a pmapperd ring (or not ready yet)";
+            return false;
+        }
+        segment_size = sizeof(Segment_t) + 2 * (size_t)capacity * sizeof(Record_t);
+    }
+
+    void * base = mmap(nullptr, segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        error = "cannot map " + path + ": " + strerror(errno);
+        return false;
+    }
+    close(fd);
+    fd = -1;
+    if (create) {
+        segment = new (base) Segment_t;
+        for (RingIndex_t & ring : segment->rings) {
+            ring.head.store(0, memory_order_relaxed);
+            ring.tail.store(0, memory_order_relaxed);
+        }
+        segment->capacity = capacity;
+        segment->record_size = sizeof(Record_t);
+        atomic_thread_fence(memory_order_release);
+        segment->magic = MAGIC;
+    } else {
+        segment = (Segment_t *)base;
+    }
+    records[0] = (Record_t *)(segment + 1);
+    records[1] = records[0] + capacity;
+    mask = capacity - 1;
+    return true;
+}
+
+bool EventChannel::Create(const string & name, bool socket, unsigned capacity, string & error) {
+    reading = 0;
+    if (!socket) {
+        unsigned size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        return map(name, true, size, error);
+    }
+
+    struct sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (name.size() >= sizeof(address.sun_path)) {
+        error = "socket path too long: " + name;
+        return false;
+    }
+    strcpy(address.sun_path, name.c_str());
+    int listener = ::socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (listener < 0) {
+        error = string("cannot create socket: ") + strerror(errno);
+        return false;
+    }
+    unlink(name.c_str());
+    if (bind(listener, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(listener, 1) != 0) {
+        error = "cannot listen on " + name + ": " + strerror(errno);
+        close(listener);
+        return false;
+    }
+    unlink_path = name;
+    fd = accept(listener, nullptr, nullptr);
+    close(listener);
+    if (fd < 0) {
+        error = "accept on " + name + " failed: " + strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+bool EventChannel::Attach(const string & name, bool socket, string & error) {
+    reading = 1;
+    struct timespec pause = {0, ATTACH_WAIT_NS};
+    for (unsigned tries = 0; tries < ATTACH_TRIES; tries++) {
+        if (tries > 0) {
+            nanosleep(&pause, nullptr);
+        }
+        if (!socket) {
+            if (map(name, false, 0, error)) {
+                return true;
+            }
+            if (fd >= 0) {
+                close(fd);
+                fd = -1;
+            }
+            continue;
+        }
+
+        struct sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        if (name.size() >= sizeof(address.sun_path)) {
+            error = "socket path too long: " + name;
+            return false;
+        }
+        strcpy(address.sun_path, name.c_str());
+        fd = ::socket(AF_UNIX, SOCK_SEQPACKET, 0);
+        if (fd < 0) {
+            error = string("cannot create socket: ") + strerror(errno);
+            return false;
+        }
+        if (connect(fd, (struct sockaddr *)&address, sizeof(address)) == 0) {
+            return true;
+        }
+        error = "cannot connect to " + name + ": " + strerror(errno);
+        close(fd);
+        fd = -1;
+    }
+    return false;
+}
+
+void EventChannel::Close() {
+    if (segment != nullptr) {
+        munmap(segment, segment_size);
+        segment = nullptr;
+    }
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+    if (!unlink_path.empty()) {
+        if (shm) {
+            shm_unlink(unlink_path.c_str());
+        } else {
+            unlink(unlink_path.c_str());
+        }
+        unlink_path.clear();
+    }
+}
+
+bool EventChannel::Send(const Record_t & record) {
+    if (!shm) {
+        return send(fd, &record, sizeof(record), MSG_NOSIGNAL) == (ssize_t)sizeof(record);
+    }
+    unsigned writing = 1 - reading;
+    RingIndex_t & ring = segment->rings[writing];
+    uint64_t head = ring.head.load(memory_order_relaxed);
+    unsigned spins = 0;
+    while (head - ring.tail.load(memory_order_acquire) > mask) {
+        backoff(spins);
+    }
+    records[writing][head & mask] = record;
+    ring.head.store(head + 1, memory_order_release);
+    return true;
+}
+
+bool EventChannel::Receive(Record_t & record, bool wait) {
+    if (!shm) {
+        ssize_t got = recv(fd, &record, sizeof(record), wait ? 0 : MSG_DONTWAIT);
+        return got == (ssize_t)sizeof(record);
+    }
+    RingIndex_t & ring = segment->rings[reading];
+    uint64_t tail = ring.tail.load(memory_order_relaxed);
+    unsigned spins = 0;
+    while (ring.head.load(memory_order_acquire) == tail) {
+        if (!wait) {
+            return false;
+        }
+        backoff(spins);
+    }
+    record = records[reading][tail & mask];
+    ring.tail.store(tail + 1, memory_order_release);
+    return true;
+}
@@ -0,0 +1,116 @@
+//
+//  EventRing.hpp
+//  CloudSim
+//
+//  The link between pmapperd and the cluster driving it. Fixed-size records
+//  go both ways: events (arrivals, completions, state changes, checks) from
+//  the cluster, actions (VMs, placements, power states) back from the
+//  scheduler.
+//
+//  The default transport is one shared-memory segment holding two
+//  single-producer single-consumer rings, one per direction. Each end only
+//  ever moves the head of the ring it writes and the tail of the ring it
+//  reads, so neither side takes a lock or makes a system call per record.
+//  Where shared memory is not an option a Unix domain socket does the same
+//  job, one SOCK_SEQPACKET message per record.
+//
+
+#ifndef EventRing_hpp
+#define EventRing_hpp
+
+#include <atomic>
+#include <string>
+
+#include "Interfaces.h"
+
+typedef enum {
+    // cluster to scheduler
+    EV_MACHINE,             // a machine of the cluster, all sent before EV_START
+    EV_START,               // the cluster is complete, InitScheduler
+    EV_TASK_ARRIVAL,
+    EV_TASK_DONE,
+    EV_STATE_DONE,          // arg.a is the state the machine is now in
+    EV_MIGRATION_DONE,
+    EV_MEMORY_WARNING,
+    EV_SLA_WARNING,
+    EV_CHECK,
+    EV_SHUTDOWN,            // SimulationComplete, then the daemon exits
+    // scheduler to cluster
+    ACT_VM_CREATE,          // arg.a vm type, arg.b cpu
+    ACT_VM_ATTACH,          // arg.a machine
+    ACT_VM_ADD_TASK,        // arg.a task, arg.b priority
+    ACT_VM_REMOVE_TASK,     // arg.a task
+    ACT_VM_MIGRATE,         // arg.a machine
+    ACT_VM_SHUTDOWN,
+    ACT_SET_STATE,          // arg.a state
+    ACT_SET_PSTATE,         // arg.a core, arg.b p-state
+    ACT_SET_PRIORITY,       // arg.a priority
+    ACT_DONE                // the event numbered seq is handled, sent_ns echoed
+} RecordType_t;
+
+typedef struct {
+    uint32_t type;
+    uint32_t id;                    // the machine, task or VM the record is about
+    uint64_t seq;                   // events are numbered by the cluster
+    Time_t time;                    // cluster time of the event
+    uint64_t sent_ns;               // when the cluster sent the event
+    union {
+        struct {
+            uint32_t num_cpus, cpu, memory, gpus;
+            uint32_t s_states[S_STATES], c_states[C_STATES], p_states[P_STATES], performance[P_STATES];
+        } machine;
+        struct {
+            uint64_t instructions;
+            Time_t target;
+            uint32_t memory, cpu, sla, vm_type, gpu, task_class;
+        } task;
+        struct {
+            uint32_t a, b;
+        } arg;
+    };
+} Record_t;
+
+class EventChannel {
+public:
+    EventChannel()              {}
+    ~EventChannel()             { Close(); }
+
+    // the daemon creates the link (and waits for the cluster to connect when
+    // it is a socket), the cluster attaches to it. capacity is in records per
+    // direction, rounded up to a power of two. false with a message in error
+    bool Create(const string & name, bool socket, unsigned capacity, string & error);
+    bool Attach(const string & name, bool socket, string & error);
+    void Close();
+
+    // spins, then yields, while the other end is behind
+    bool Send(const Record_t & record);
+    // false if nothing is waiting and wait is not set, or (on a socket) the
+    // other end has gone away
+    bool Receive(Record_t & record, bool wait);
+
+private:
+    typedef struct {
+        alignas(64) atomic<uint64_t> head;      // next record to write
+        alignas(64) atomic<uint64_t> tail;      // next record to read
+    } RingIndex_t;
+
+    typedef struct {
+        uint64_t magic;
+        uint32_t capacity;
+        uint32_t record_size;
+        RingIndex_t rings[2];                   // events in rings[0], actions in rings[1]
+    } Segment_t;
+
+    bool map(const string & name, bool create, unsigned capacity, string & error);
+
+    Segment_t * segment = nullptr;
+    size_t segment_size = 0;
+    Record_t * records[2] = {nullptr, nullptr};
+    unsigned reading = 0;                       // the ring this end reads, the other it writes
+    uint64_t mask = 0;
+    int fd = -1;
+    string unlink_path;                         // what the creating end removes on Close
+    bool shm = false;
+};
+
+#endif /* EventRing_hpp */
@@ -0,0 +1,249 @@
+//
+//  Mirror.cpp
+//  CloudSim
+//
+
+#include "Mirror.hpp"
+#include "WorkloadCache.hpp"
+
+#include <stdexcept>
+
+static EventChannel * cluster = nullptr;
+static unsigned verbosity = 0;
+static Time_t now = 0;
+
+static vector<MachineInfo_t> machines;
+static vector<VMInfo_t> vms;
+static vector<bool> vm_alive;
+static vector<MachineId_t> vm_target;       // where a migrating VM is going
+static vector<TaskInfo_t> tasks;
+static vector<TaskClass_t> task_class;
+static vector<VMId_t> task_vm;
+
+static void publish(RecordType_t type, uint32_t id, uint32_t a, uint32_t b = 0) {
+    Record_t action = {};
+    action.type = type;
+    action.id = id;
+    action.time = now;
+    action.arg.a = a;
+    action.arg.b = b;
+    if (!cluster->Send(action)) {
+        throw runtime_error("the cluster has gone away");
+    }
+}
+
+void Mirror_Bind(EventChannel * channel, unsigned verbose) {
+    cluster = channel;
+    verbosity = verbose;
+}
+
+void Mirror_SetNow(Time_t time) {
+    now = max(now, time);
+}
+
+void Mirror_AddMachine(const Record_t & record) {
+    MachineInfo_t machineInfo;
+    machineInfo.num_cpus = record.machine.num_cpus;
+    machineInfo.cpu = CPUType_t(record.machine.cpu);
+    machineInfo.memory_size = record.machine.memory;
+    machineInfo.memory_used = 0;
+    machineInfo.active_tasks = 0;
+    machineInfo.active_vms = 0;
+    machineInfo.gpus = record.machine.gpus != 0;
+    machineInfo.energy_consumed = 0;
+    machineInfo.performance.assign(record.machine.performance, record.machine.performance + P_STATES);
+    machineInfo.c_states.assign(record.machine.c_states, record.machine.c_states + C_STATES);
+    machineInfo.p_states.assign(record.machine.p_states, record.machine.p_states + P_STATES);
+    machineInfo.s_states.assign(record.machine.s_states, record.machine.s_states + S_STATES);
+    machineInfo.s_state = S0;
+    machineInfo.p_state = P0;
+    machineInfo.machine_id = record.id;
+    if (record.id >= machines.size()) {
+        machines.resize(record.id + 1);
+    }
+    machines[record.id] = machineInfo;
+}
+
+TaskId_t Mirror_AddTask(const Record_t & record) {
+    TaskId_t task_id = record.id;
+    if (task_id >= tasks.size()) {
+        tasks.resize(task_id + 1);
+        task_class.resize(task_id + 1);
+        task_vm.resize(task_id + 1, UINT32_MAX);
+    }
+    TaskInfo_t & task = tasks[task_id];
+    task.completed = false;
+    task.total_instructions = task.remaining_instructions = record.task.instructions;
+    task.arrival = record.time;
+    task.completion = 0;
+    task.target_completion = record.task.target;
+    task.gpu_capable = record.task.gpu != 0;
+    task.priority = MID_PRIORITY;
+    task.required_cpu = CPUType_t(record.task.cpu);
+    task.required_memory = record.task.memory;
+    task.required_sla = SLAType_t(record.task.sla);
+    task.required_vm = VMType_t(record.task.vm_type);
+    task.task_id = task_id;
+    task_class[task_id] = TaskClass_t(record.task.task_class);
+    return task_id;
+}
+
+// takes the task off its VM and machine, without telling the cluster
+static bool detach(VMId_t vm_id, TaskId_t task_id) {
+    vector<TaskId_t> & active = vms[vm_id].active_tasks;
+    for (auto it = active.begin(); it != active.end(); it++) {
+        if (*it == task_id) {
+            active.erase(it);
+            MachineInfo_t & machineInfo = machines[vms[vm_id].machine_id];
+            machineInfo.active_tasks--;
+            machineInfo.memory_used -= tasks[task_id].required_memory;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Mirror_FinishTask(TaskId_t task_id) {
+    TaskInfo_t & task = tasks[task_id];
+    if (task_vm[task_id] < vms.size()) {
+        detach(task_vm[task_id], task_id);
+    }
+    task.completed = true;
+    task.completion = now;
+    task.remaining_instructions = 0;
+}
+
+void Mirror_StateDone(MachineId_t machine_id, MachineState_t s_state) {
+    machines[machine_id].s_state = s_state;
+}
+
+void Mirror_MigrationDone(VMId_t vm_id) {
+    VMInfo_t & vm = vms[vm_id];
+    MachineInfo_t & from = machines[vm.machine_id];
+    MachineInfo_t & to = machines[vm_target[vm_id]];
+    unsigned memory = VM_MEMORY_OVERHEAD;
+    for (TaskId_t task_id : vm.active_tasks) {
+        memory += tasks[task_id].required_memory;
+    }
+    from.active_vms--;
+    from.active_tasks -= vm.active_tasks.size();
+    from.memory_used -= memory;
+    to.active_vms++;
+    to.active_tasks += vm.active_tasks.size();
+    to.memory_used += memory;
+    vm.machine_id = vm_target[vm_id];
+}
+
+// Debugging Interface
+void SimOutput(string msg, unsigned verbose_level) {
+    if (verbose_level <= verbosity) {
+        cerr << msg << endl;
+    }
+}
+void ThrowException(string err_msg) { throw runtime_error(err_msg); }
+void ThrowException(string err_msg, string further_input) { throw runtime_error(err_msg + further_input); }
+void ThrowException(string err_msg, unsigned further_input) { throw runtime_error(err_msg + to_string(further_input)); }
+
+// Machine Interface
+CPUType_t Machine_GetCPUType(MachineId_t machine_id) { return machines[machine_id].cpu; }
+uint64_t Machine_GetEnergy(MachineId_t machine_id) { return 0; }
+double Machine_GetClusterEnergy() { return 0; }
+MachineInfo_t Machine_GetInfo(MachineId_t machine_id) { return machines[machine_id]; }
+unsigned Machine_GetTotal() { return machines.size(); }
+
+void Machine_SetCorePerformance(MachineId_t machine_id, unsigned core_id, CPUPerformance_t p_state) {
+    machines[machine_id].p_state = p_state;
+    publish(ACT_SET_PSTATE, machine_id, core_id, p_state);
+}
+
+void Machine_SetState(MachineId_t machine_id, MachineState_t s_state) {
+    publish(ACT_SET_STATE, machine_id, s_state);
+}
+
+// Statistics, over the tasks finished so far
+double GetSLAReport(SLAType_t sla) {
+    unsigned total = 0, missed = 0;
+    for (const TaskInfo_t & task : tasks) {
+        if (task.completed && task.required_sla == sla) {
+            total++;
+            missed += task.completion > task.target_completion;
+        }
+    }
+    return total == 0 ? 0 : 100.0 * missed / total;
+}
+
+// Simulator Interface
+Time_t Now() { return now; }
+
+// Task Interface. the cluster does not say how many tasks are coming, so
+// the count is of those seen so far
+unsigned GetNumTasks() { return tasks.size(); }
+TaskInfo_t GetTaskInfo(TaskId_t task_id) { return tasks[task_id]; }
+unsigned GetTaskMemory(TaskId_t task_id) { return tasks[task_id].required_memory; }
+unsigned GetTaskPriority(TaskId_t task_id) { return tasks[task_id].priority; }
+bool IsTaskCompleted(TaskId_t task_id) { return tasks[task_id].completed; }
+bool IsTaskGPUCapable(TaskId_t task_id) { return tasks[task_id].gpu_capable; }
+CPUType_t RequiredCPUType(TaskId_t task_id) { return tasks[task_id].required_cpu; }
+SLAType_t RequiredSLA(TaskId_t task_id) { return tasks[task_id].required_sla; }
+VMType_t RequiredVMType(TaskId_t task_id) { return tasks[task_id].required_vm; }
+TaskClass_t GetTaskClass(TaskId_t task_id) { return task_class[task_id]; }
+
+bool IsSLAViolated(TaskId_t task_id) {
+    const TaskInfo_t & task = tasks[task_id];
+    return (task.completed ? task.completion : now) > task.target_completion;
+}
+
+void SetTaskPriority(TaskId_t task_id, Priority_t priority) {
+    tasks[task_id].priority = priority;
+    publish(ACT_SET_PRIORITY, task_id, priority);
+}
+
+// VM Interface
+VMId_t VM_Create(VMType_t vm_type, CPUType_t cpu) {
+    VMId_t vm_id = vms.size();
+    vms.push_back({{}, cpu, 0, vm_id, vm_type});
+    vm_alive.push_back(true);
+    vm_target.push_back(0);
+    publish(ACT_VM_CREATE, vm_id, vm_type, cpu);
+    return vm_id;
+}
+
+void VM_Attach(VMId_t vm_id, MachineId_t machine_id) {
+    vms[vm_id].machine_id = machine_id;
+    machines[machine_id].active_vms++;
+    machines[machine_id].memory_used += VM_MEMORY_OVERHEAD;
+    publish(ACT_VM_ATTACH, vm_id, machine_id);
+}
+
+void VM_AddTask(VMId_t vm_id, TaskId_t task_id, Priority_t priority) {
+    MachineInfo_t & machineInfo = machines[vms[vm_id].machine_id];
+    vms[vm_id].active_tasks.push_back(task_id);
+    machineInfo.active_tasks++;
+    machineInfo.memory_used += tasks[task_id].required_memory;
+    tasks[task_id].priority = priority;
+    task_vm[task_id] = vm_id;
+    publish(ACT_VM_ADD_TASK, vm_id, task_id, priority);
+}
+
+VMInfo_t VM_GetInfo(VMId_t vm_id) { return vms[vm_id]; }
+
+void VM_Migrate(VMId_t vm_id, MachineId_t machine_id) {
+    vm_target[vm_id] = machine_id;
+    publish(ACT_VM_MIGRATE, vm_id, machine_id);
+}
+
+void VM_RemoveTask(VMId_t vm_id, TaskId_t task_id) {
+    if (detach(vm_id, task_id)) {
+        publish(ACT_VM_REMOVE_TASK, vm_id, task_id);
+    }
+}
+
+void VM_Shutdown(VMId_t vm_id) {
+    if (!vm_alive[vm_id]) {
+        return;
+    }
+    vm_alive[vm_id] = false;
+    machines[vms[vm_id].machine_id].active_vms--;
+    machines[vms[vm_id].machine_id].memory_used -= VM_MEMORY_OVERHEAD;
+    publish(ACT_VM_SHUTDOWN, vm_id, 0);
+}
@@ -0,0 +1,34 @@
+//
+//  Mirror.hpp
+//  CloudSim
+//
+//  What pmapperd knows of the cluster, behind Interfaces.h, so the scheduler
+//  runs in the daemon unchanged. Machines, VMs and tasks are tables filled
+//  from events. Calls that change the cluster update the tables straight
+//  away, as the simulator would, and go out on the channel as actions.
+//  Machine_SetState is the exception: the state only changes once the
+//  cluster reports it with EV_STATE_DONE, and StateChangeComplete is called
+//  from there. Energy is the cluster's to account, so it reads as zero here.
+//
+
+#ifndef Mirror_hpp
+#define Mirror_hpp
+
+#include "EventRing.hpp"
+
+// actions go out on channel; SimOutput messages up to verbose go to stderr
+void        Mirror_Bind(EventChannel * channel, unsigned verbose);
+void        Mirror_SetNow(Time_t time);
+
+// machine and task ids are the cluster's, handed out densely from 0. VM ids
+// are the daemon's, the cluster learns them from ACT_VM_CREATE
+void        Mirror_AddMachine(const Record_t & record);
+TaskId_t    Mirror_AddTask(const Record_t & record);
+
+// what the simulator does before HandleTaskCompletion, StateChangeComplete
+// and MigrationDone
+void        Mirror_FinishTask(TaskId_t task_id);
+void        Mirror_StateDone(MachineId_t machine_id, MachineState_t s_state);
+void        Mirror_MigrationDone(VMId_t vm_id);
+
+#endif /* Mirror_hpp */
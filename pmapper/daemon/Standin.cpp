@@ -0,0 +1,392 @@
+//
+//  Standin.cpp
+//  CloudSim
+//
+//  A stand-in cluster for pmapperd. It attaches to the daemon's channel,
+//  announces its machines and then plays out a stream of tasks against
+//  whatever the scheduler decides, as fast as the daemon keeps up:
+//
+//  - tasks arrive Poisson, run for their instructions at the machine's P0
+//    speed once it is awake, and report completion. load does not slow
+//    them down, and there are no memory or SLA warnings
+//  - a state change lands after a latency that grows with how deep the
+//    deeper of the two states is; migrations take a fixed time
+//  - a check goes out every 60 ms of cluster time, as the simulator does
+//
+//  Cluster time only moves forward as events are sent, up to -w of them
+//  ahead of the daemon's answers (-w 1 runs in lock step). Each event's
+//  decision latency is from its send to the ACT_DONE coming back; the
+//  report gives those, the sustained events/sec, and the SLA misses.
+//
+//  usage: standin [-u] [-m machines] [-n tasks] [-a inter_arrival_us]
+//                 [-r runtime_us] [-w window] [-s seed] name
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <queue>
+#include <random>
+#include <unistd.h>
+
+#include "EventRing.hpp"
+
+static const Time_t CHECK_PERIOD = 60000;
+static const Time_t MIGRATION_TIME = 500000;
+// runtimes past the last arrival before parked tasks are given up on
+static const Time_t STALL_LIMIT = 100;
+// entering or leaving a state, by the deeper of the two
+static const Time_t STATE_LATENCY[S_STATES] = {0, 100, 1000, 10000, 100000, 300000, 1000000};
+// MIPS at P0 to P3 and power in S0 to S5 for each machine kind
+static const unsigned MIPS[4][P_STATES] = {
+    {1000, 800, 600, 400},
+    {1500, 1200, 900, 600},
+    {2000, 1600, 1200, 800},
+    {3000, 2400, 1800, 1200},
+};
+static const unsigned S_POWER[S_STATES] = {120, 100, 80, 60, 40, 10, 0};
+
+typedef struct {
+    bool socket;
+    unsigned machines;
+    unsigned tasks;
+    Time_t inter_arrival;
+    Time_t runtime;
+    unsigned window;
+    unsigned seed;
+    string name;
+} Options_t;
+
+typedef struct {
+    CPUType_t cpu;
+    unsigned mips;
+    MachineState_t state;
+    vector<TaskId_t> parked;            // placed while the machine was not up
+} Machine_t;
+
+typedef struct {
+    uint64_t instructions;
+    Time_t target;
+    SLAType_t sla;
+    Time_t completion;
+    bool removed;
+} Task_t;
+
+typedef struct {
+    Time_t time;
+    uint64_t order;
+    Record_t record;
+} Pending_t;
+
+struct Later {
+    bool operator()(const Pending_t & a, const Pending_t & b) const {
+        return a.time != b.time ? a.time > b.time : a.order > b.order;
+    }
+};
+
+class Cluster {
+public:
+    Cluster(const Options_t & options) : options(options), rng(options.seed) {}
+    int Run();
+
+private:
+    void schedule(Time_t time, RecordType_t type, uint32_t id, uint32_t a = 0);
+    void start(TaskId_t task_id, MachineId_t machine_id);
+    void apply(const Record_t & action);
+    bool settle(unsigned limit);
+    bool send(Record_t & event);
+    void report(double seconds) const;
+
+    Options_t options;
+    mt19937_64 rng;
+    EventChannel channel;
+    vector<Machine_t> machines;
+    vector<MachineId_t> vm_machine;
+    vector<Task_t> tasks;
+    priority_queue<Pending_t, vector<Pending_t>, Later> pending;
+    uint64_t order = 0;
+    uint64_t seq = 0;
+    Time_t now = 0;
+    unsigned outstanding = 0;
+    unsigned running = 0;
+    uint64_t actions = 0;
+    vector<double> latency[EV_SHUTDOWN + 1];
+};
+
+static uint64_t steadyNs() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Cluster::schedule(Time_t time, RecordType_t type, uint32_t id, uint32_t a) {
+    Pending_t next = {time, order++, {}};
+    next.record.type = type;
+    next.record.id = id;
+    next.record.arg.a = a;
+    pending.push(next);
+}
+
+void Cluster::start(TaskId_t task_id, MachineId_t machine_id) {
+    Task_t & task = tasks[task_id];
+    schedule(now + task.instructions / machines[machine_id].mips, EV_TASK_DONE, task_id);
+}
+
+void Cluster::apply(const Record_t & action) {
+    actions++;
+    switch (action.type) {
+        case ACT_DONE:
+            outstanding--;
+            latency[action.id].push_back((steadyNs() - action.sent_ns) / 1000.0);
+            break;
+        case ACT_VM_CREATE:
+            if (action.id >= vm_machine.size()) {
+                vm_machine.resize(action.id + 1, 0);
+            }
+            break;
+        case ACT_VM_ATTACH:
+            vm_machine[action.id] = action.arg.a;
+            break;
+        case ACT_VM_ADD_TASK: {
+            MachineId_t machine_id = vm_machine[action.id];
+            running++;
+            if (machines[machine_id].state == S0) {
+                start(action.arg.a, machine_id);
+            } else {
+                machines[machine_id].parked.push_back(action.arg.a);
+            }
+            break;
+        }
+        case ACT_VM_REMOVE_TASK:
+            tasks[action.arg.a].removed = true;
+            break;
+        case ACT_VM_MIGRATE:
+            vm_machine[action.id] = action.arg.a;
+            schedule(now + MIGRATION_TIME, EV_MIGRATION_DONE, action.id);
+            break;
+        case ACT_SET_STATE: {
+            MachineState_t from = machines[action.id].state;
+            MachineState_t to = MachineState_t(action.arg.a);
+            schedule(now + STATE_LATENCY[max(from, to)], EV_STATE_DONE, action.id, to);
+            break;
+        }
+        default:
+            break;                      // p-states, priorities and shutdowns change nothing here
+    }
+}
+
+// takes actions in until no more than limit events are unanswered
+bool Cluster::settle(unsigned limit) {
+    Record_t action;
+    while (outstanding > limit) {
+        if (!channel.Receive(action, true)) {
+            return false;
+        }
+        apply(action);
+    }
+    return true;
+}
+
+bool Cluster::send(Record_t & event) {
+    event.seq = seq++;
+    event.time = now;
+    event.sent_ns = steadyNs();
+    outstanding++;
+    return channel.Send(event);
+}
+
+static void percentiles(const char * label, vector<double> values) {
+    if (values.empty()) {
+        return;
+    }
+    sort(values.begin(), values.end());
+    auto at = [&](double q) { return values[min(values.size() - 1, (size_t)(q * values.size()))]; };
+    printf("%-12s %9zu %9.1f %9.1f %9.1f %9.1f %9.1f\n", label, values.size(), at(0.5), at(0.9), at(0.99), at(0.999), values.back());
+}
+
+void Cluster::report(double seconds) const {
+    static const char * NAMES[EV_SHUTDOWN + 1] = {"machine", "start", "arrival", "done", "state", "migration",
+                                                  "memory", "sla", "check", "shutdown"};
+    uint64_t events = 0;
+    vector<double> all;
+    for (const vector<double> & values : latency) {
+        events += values.size();
+        all.insert(all.end(), values.begin(), values.end());
+    }
+    printf("%u machines, %u tasks, %s, window %u\n", options.machines, options.tasks,
+           options.socket ? "unix socket" : "shared-memory ring", options.window);
+    printf("%llu events and %llu actions in %.3f s: %.0f events/s\n", (unsigned long long)events,
+           (unsigned long long)(actions - events), seconds, events / seconds);
+    printf("%-12s %9s %9s %9s %9s %9s %9s\n", "latency us", "count", "p50", "p90", "p99", "p99.9", "max");
+    percentiles("all", all);
+    for (unsigned type = EV_TASK_ARRIVAL; type <= EV_CHECK; type++) {
+        percentiles(NAMES[type], latency[type]);
+    }
+
+    unsigned missed[NUM_SLAS] = {}, total[NUM_SLAS] = {};
+    for (const Task_t & task : tasks) {
+        if (task.completion > 0) {
+            total[task.sla]++;
+            missed[task.sla] += task.completion > task.target;
+        }
+    }
+    printf("SLA misses:");
+    for (unsigned sla = 0; sla < NUM_SLAS; sla++) {
+        printf(" SLA%u %.1f%%", sla, total[sla] == 0 ? 0.0 : 100.0 * missed[sla] / total[sla]);
+    }
+    printf(", cluster time %.1f s\n", now / 1000000.0);
+}
+
+int Cluster::Run() {
+    string error;
+    if (!channel.Attach(options.name, options.socket, error)) {
+        fprintf(stderr, "standin: %s\n", error.c_str());
+        return 1;
+    }
+
+    // the same spread as microbench/SimStub.cpp
+    for (unsigned i = 0; i < options.machines; i++) {
+        Record_t event = {};
+        event.type = EV_MACHINE;
+        event.id = i;
+        event.machine.num_cpus = 8;
+        event.machine.cpu = i % 4;
+        event.machine.memory = 32768;
+        const unsigned * mips = MIPS[(i / 4) % 4];
+        copy(mips, mips + P_STATES, event.machine.performance);
+        copy(S_POWER, S_POWER + S_STATES, event.machine.s_states);
+        unsigned c_states[C_STATES] = {120, 40, 20, 0};
+        unsigned p_states[P_STATES] = {120 + 10 * (i % 7), 100, 80, 60};
+        copy(c_states, c_states + C_STATES, event.machine.c_states);
+        copy(p_states, p_states + P_STATES, event.machine.p_states);
+        machines.push_back({CPUType_t(i % 4), mips[P0], S0, {}});
+        if (!settle(options.window - 1) || !send(event)) {
+            fprintf(stderr, "standin: the daemon has gone away\n");
+            return 1;
+        }
+    }
+    Record_t begin = {};
+    begin.type = EV_START;
+    send(begin);
+
+    exponential_distribution<double> gap(1.0 / options.inter_arrival);
+    uniform_real_distribution<double> spread(0.5, 1.5);
+    Time_t next_arrival = 0;
+    TaskId_t arrived = 0;
+    Time_t next_check = CHECK_PERIOD;
+    uint64_t started = steadyNs();
+
+    for (;;) {
+        bool more = arrived < options.tasks || !pending.empty();
+        Record_t action;
+        if (channel.Receive(action, outstanding >= options.window || (!more && outstanding > 0))) {
+            apply(action);
+            continue;
+        }
+        if (outstanding >= options.window || (!more && outstanding > 0)) {
+            fprintf(stderr, "standin: the daemon has gone away\n");
+            return 1;
+        }
+        if (!more) {
+            break;
+        }
+
+        // the earliest of the next arrival, the next check and whatever is pending
+        Time_t next_pending = pending.empty() ? UINT64_MAX : pending.top().time;
+        Time_t arrival = arrived < options.tasks ? next_arrival : UINT64_MAX;
+        Record_t event = {};
+        if (next_check <= min(arrival, next_pending)) {
+            now = next_check;
+            next_check += CHECK_PERIOD;
+            event.type = EV_CHECK;
+        } else if (arrival <= next_pending) {
+            now = arrival;
+            next_arrival += (Time_t)gap(rng) + 1;
+            Time_t runtime = (Time_t)(options.runtime * spread(rng));
+            SLAType_t sla = SLAType_t(arrived % 3);
+            tasks.push_back({runtime * 1000ull, now + runtime * (3 + sla), sla, 0, false});
+            event.type = EV_TASK_ARRIVAL;
+            event.id = arrived++;
+            event.task.instructions = tasks.back().instructions;
+            event.task.target = tasks.back().target;
+            event.task.memory = 256 << (rng() % 4);
+            event.task.cpu = rng() % 4;
+            event.task.sla = sla;
+            event.task.vm_type = LINUX;
+            event.task.gpu = 0;
+            event.task.task_class = WEB_REQUEST;
+        } else {
+            Pending_t next = pending.top();
+            pending.pop();
+            now = max(now, next.time);
+            event = next.record;
+            if (event.type == EV_TASK_DONE) {
+                Task_t & task = tasks[event.id];
+                if (task.removed) {
+                    continue;
+                }
+                task.completion = now;
+                running--;
+            } else if (event.type == EV_STATE_DONE) {
+                Machine_t & machine = machines[event.id];
+                machine.state = MachineState_t(event.arg.a);
+                if (machine.state == S0) {
+                    for (TaskId_t task_id : machine.parked) {
+                        start(task_id, event.id);
+                    }
+                    machine.parked.clear();
+                }
+            }
+        }
+        if (!send(event)) {
+            fprintf(stderr, "standin: the daemon has gone away\n");
+            return 1;
+        }
+        // checks only keep going while there is work about, or for a while
+        // if tasks are parked on machines nobody wakes
+        bool drained = arrived == options.tasks && pending.empty();
+        if (drained && (running == 0 || now > next_arrival + STALL_LIMIT * options.runtime)) {
+            next_check = UINT64_MAX;
+        }
+    }
+
+    Record_t shutdown = {};
+    shutdown.type = EV_SHUTDOWN;
+    if (!send(shutdown) || !settle(0)) {
+        fprintf(stderr, "standin: the daemon has gone away\n");
+        return 1;
+    }
+    if (running > 0) {
+        fprintf(stderr, "standin: %u tasks never ran, their machines were left asleep\n", running);
+    }
+    report((steadyNs() - started) / 1e9);
+    return 0;
+}
+
+static void usage() {
+    fprintf(stderr, "usage: standin [-u] [-m machines] [-n tasks] [-a inter_arrival_us] [-r runtime_us]\n"
+                    "               [-w window] [-s seed] name\n");
+    exit(2);
+}
+
+int main(int argc, char * argv[]) {
+    Options_t options = {false, 1000, 100000, 2000, 2000000, 64, 1, ""};
+    int opt;
+    while ((opt = getopt(argc, argv, "um:n:a:r:w:s:")) != -1) {
+        switch (opt) {
+            case 'u': options.socket = true; break;
+            case 'm': options.machines = max(1, atoi(optarg)); break;
+            case 'n': options.tasks = max(1, atoi(optarg)); break;
+            case 'a': options.inter_arrival = max(1ll, atoll(optarg)); break;
+            case 'r': options.runtime = max(1ll, atoll(optarg)); break;
+            case 'w': options.window = max(1, atoi(optarg)); break;
+            case 's': options.seed = atoi(optarg); break;
+            default: usage();
+        }
+    }
+    if (optind != argc - 1) {
+        usage();
+    }
+    options.name = argv[optind];
+    Cluster cluster(options);
+    return cluster.Run();
+}
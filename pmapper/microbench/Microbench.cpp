@@ -0,0 +1,237 @@
+//
+//  Microbench.cpp
+//  CloudSim
+//
+//  Times scheduler internals against the stubbed simulator in SimStub.cpp:
+//  startup (Init), the task queue, placement (handleQueue), VM bookkeeping
+//  on completion (TaskComplete) and the periodic power walk (PeriodicCheck),
+//  each at 16, 1k, 10k and 100k machines. Every run is WARMUP untimed repetitions
+//  then REPS timed ones, reported as the median and MAD per operation.
+//
+//  The scheduler keeps its state in statics, so each benchmark and size
+//  runs in a process of its own.
+//
+//  usage: microbench [init|queue|place|check ...]    (place also times completion)
+//
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <queue>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "Scheduler.hpp"
+#include "SimStub.hpp"
+
+static const unsigned SIZES[] = {16, 1000, 10000, 100000};
+static const unsigned WARMUP = 3;
+static const unsigned REPS = 15;
+static const Time_t CHECK_PERIOD = 60000;      // what the simulator uses
+
+typedef chrono::steady_clock Clock;
+
+static double nsPer(Clock::time_point start, unsigned ops) {
+    return chrono::duration<double, nano>(Clock::now() - start).count() / max(1u, ops);
+}
+
+static double median(vector<double> sample) {
+    sort(sample.begin(), sample.end());
+    size_t mid = sample.size() / 2;
+    return sample.size() % 2 ? sample[mid] : (sample[mid - 1] + sample[mid]) / 2;
+}
+
+static void report(const char * bench, unsigned machines, const char * unit, const vector<double> & sample) {
+    double center = median(sample);
+    vector<double> deviation;
+    for (double x : sample) {
+        deviation.push_back(fabs(x - center));
+    }
+    printf("%-10s %8u %14.1f %12.1f  %s\n", bench, machines, center, median(deviation), unit);
+    fflush(stdout);
+}
+
+// Init only runs once per process, so each repetition gets a fork of its own
+// and sends its time back through a pipe
+static void benchInit(unsigned machines) {
+    Stub_Setup(machines, 0);
+    vector<double> sample;
+    for (unsigned rep = 0; rep < WARMUP + REPS; rep++) {
+        int channel[2];
+        if (pipe(channel) != 0) {
+            _exit(1);
+        }
+        pid_t child = fork();
+        if (child == 0) {
+            close(channel[0]);
+            auto start = Clock::now();
+            InitScheduler();
+            double ns = nsPer(start, 1);
+            _exit(write(channel[1], &ns, sizeof(ns)) == sizeof(ns) ? 0 : 1);
+        }
+        close(channel[1]);
+        double ns = 0;
+        bool ok = read(channel[0], &ns, sizeof(ns)) == sizeof(ns);
+        close(channel[0]);
+        int childStatus = 0;
+        waitpid(child, &childStatus, 0);
+        if (!ok || !WIFEXITED(childStatus) || WEXITSTATUS(childStatus) != 0) {
+            _exit(1);
+        }
+        if (rep >= WARMUP) {
+            sample.push_back(ns / 1000);
+        }
+    }
+    report("init", machines, "us/init", sample);
+}
+
+// TaskPriorityComparator ordering, queue as long as the cluster is big
+static void benchQueue(unsigned machines) {
+    Stub_Setup(0, machines);
+    vector<TaskId_t> order;
+    for (unsigned i = 0; i < machines; i++) {
+        order.push_back(Stub_NextTask(i));
+    }
+    uint64_t seed = 1;
+    for (unsigned i = order.size(); i > 1; i--) {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        swap(order[i - 1], order[(seed >> 33) % i]);
+    }
+
+    vector<double> sample;
+    for (unsigned rep = 0; rep < WARMUP + REPS; rep++) {
+        priority_queue<TaskId_t, vector<TaskId_t>, TaskPriorityComparator> queue;
+        auto start = Clock::now();
+        for (TaskId_t task_id : order) {
+            queue.push(task_id);
+        }
+        while (!queue.empty()) {
+            queue.pop();
+        }
+        if (rep >= WARMUP) {
+            sample.push_back(nsPer(start, order.size()));
+        }
+    }
+    report("queue", machines, "ns/push+pop", sample);
+}
+
+// a batch of arrivals on an idle cluster, then all of them finishing. the
+// batch fits in a quarter of the VM slots
+static unsigned batchSize(unsigned machines) {
+    return min(machines * 2, 2048u);
+}
+
+static void benchPlace(unsigned machines) {
+    unsigned batch = batchSize(machines);
+    Stub_Setup(machines, batch * (WARMUP + REPS));
+    InitScheduler();
+
+    vector<double> placing, completing;
+    Time_t now = 0;
+    for (unsigned rep = 0; rep < WARMUP + REPS; rep++) {
+        now += 1000000;
+        Stub_SetNow(now);
+        vector<TaskId_t> arrived;
+        auto start = Clock::now();
+        for (unsigned i = 0; i < batch; i++) {
+            arrived.push_back(Stub_NextTask(now));
+            HandleNewTask(now, arrived.back());
+        }
+        double placeNs = nsPer(start, batch);
+
+        start = Clock::now();
+        for (TaskId_t task_id : arrived) {
+            Stub_FinishTask(task_id);
+            HandleTaskCompletion(now, task_id);
+        }
+        double completeNs = nsPer(start, batch);
+        if (rep >= WARMUP) {
+            placing.push_back(placeNs);
+            completing.push_back(completeNs);
+        }
+    }
+    report("place", machines, "ns/task", placing);
+    report("complete", machines, "ns/task", completing);
+}
+
+// half of two batches still running, so the power walk has idle machines to
+// step down and busy ones to skip
+static void benchCheck(unsigned machines) {
+    unsigned batch = batchSize(machines);
+    Stub_Setup(machines, 2 * batch);
+    InitScheduler();
+    vector<TaskId_t> arrived;
+    for (unsigned i = 0; i < 2 * batch; i++) {
+        arrived.push_back(Stub_NextTask(0));
+        HandleNewTask(0, arrived.back());
+    }
+    for (unsigned i = 0; i < batch; i++) {
+        Stub_FinishTask(arrived[i]);
+        HandleTaskCompletion(0, arrived[i]);
+    }
+
+    vector<double> sample;
+    Time_t now = 0;
+    for (unsigned rep = 0; rep < WARMUP + REPS; rep++) {
+        now += CHECK_PERIOD;
+        Stub_SetNow(now);
+        auto start = Clock::now();
+        SchedulerCheck(now);
+        if (rep >= WARMUP) {
+            sample.push_back(nsPer(start, 1));
+        }
+    }
+    report("check", machines, "ns/check", sample);
+}
+
+static void run(const char * bench, unsigned machines) {
+    // the scheduler's progress output would swamp (and skew) the numbers
+    cout.setstate(ios::badbit);
+    if (strcmp(bench, "init") == 0) {
+        benchInit(machines);
+    } else if (strcmp(bench, "queue") == 0) {
+        benchQueue(machines);
+    } else if (strcmp(bench, "place") == 0) {
+        benchPlace(machines);
+    } else if (strcmp(bench, "check") == 0) {
+        benchCheck(machines);
+    }
+}
+
+int main(int argc, char * argv[]) {
+    vector<const char *> benches;
+    for (int i = 1; i < argc; i++) {
+        benches.push_back(argv[i]);
+    }
+    if (benches.empty()) {
+        benches = {"init", "queue", "place", "check"};
+    }
+    for (const char * bench : benches) {
+        if (strcmp(bench, "init") != 0 && strcmp(bench, "queue") != 0 && strcmp(bench, "place") != 0 && strcmp(bench, "check") != 0) {
+            fprintf(stderr, "unknown benchmark %s\n", bench);
+            return 2;
+        }
+    }
+
+    printf("%-10s %8s %14s %12s  %s\n", "bench", "machines", "median", "MAD", "unit");
+    fflush(stdout);
+    int status = 0;
+    for (const char * bench : benches) {
+        for (unsigned machines : SIZES) {
+            pid_t child = fork();
+            if (child == 0) {
+                run(bench, machines);
+                _exit(0);
+            }
+            int childStatus = 0;
+            waitpid(child, &childStatus, 0);
+            if (!WIFEXITED(childStatus) || WEXITSTATUS(childStatus) != 0) {
+                fprintf(stderr, "%s at %u machines failed\n", bench, machines);
+                status = 1;
+            }
+        }
+    }
+    return status;
+}
@@ -0,0 +1,177 @@
+//
+//  SimStub.cpp
+//  CloudSim
+//
+
+#include "SimStub.hpp"
+#include "WorkloadCache.hpp"
+
+static vector<MachineInfo_t> machines;
+static vector<VMInfo_t> vms;
+static vector<bool> vm_alive;
+static vector<TaskInfo_t> tasks;
+static vector<VMId_t> task_vm;
+static TaskId_t next_task = 0;
+static Time_t now = 0;
+
+// a spread of speeds, so the efficiency order is not just machine id order
+static const unsigned MIPS[4][P_STATES] = {
+    {1000, 800, 600, 400},
+    {1500, 1200, 900, 600},
+    {2000, 1600, 1200, 800},
+    {3000, 2400, 1800, 1200},
+};
+
+void Stub_Setup(unsigned num_machines, unsigned num_tasks) {
+    machines.clear();
+    for (unsigned i = 0; i < num_machines; i++) {
+        MachineInfo_t machineInfo;
+        machineInfo.num_cpus = 8;
+        machineInfo.cpu = CPUType_t(i % 4);
+        machineInfo.memory_size = 32768;
+        machineInfo.memory_used = 0;
+        machineInfo.active_tasks = 0;
+        machineInfo.active_vms = 0;
+        machineInfo.gpus = false;
+        machineInfo.energy_consumed = 0;
+        const unsigned * mips = MIPS[(i / 4) % 4];
+        machineInfo.performance.assign(mips, mips + P_STATES);
+        machineInfo.c_states = {120, 40, 20, 0};
+        machineInfo.p_states = {120 + 10 * (i % 7), 100, 80, 60};
+        machineInfo.s_state = S0;
+        machineInfo.p_state = P0;
+        machineInfo.machine_id = i;
+        machines.push_back(machineInfo);
+    }
+    vms.clear();
+    vm_alive.clear();
+
+    // SLA0-2 only, SLA3 would sit in the deferral lane
+    tasks.resize(num_tasks);
+    task_vm.assign(num_tasks, 0);
+    for (unsigned i = 0; i < num_tasks; i++) {
+        TaskInfo_t & task = tasks[i];
+        task.completed = false;
+        task.total_instructions = task.remaining_instructions = 1000000ull * (1 + i % 50);
+        task.arrival = 0;
+        task.completion = 0;
+        task.target_completion = 0;
+        task.gpu_capable = false;
+        task.priority = MID_PRIORITY;
+        task.required_cpu = CPUType_t(i % 4);
+        task.required_memory = 256 << (i % 4);
+        task.required_sla = SLAType_t(i % 3);
+        task.required_vm = LINUX;
+        task.task_id = i;
+    }
+    next_task = 0;
+    now = 0;
+}
+
+TaskId_t Stub_NextTask(Time_t arrival) {
+    TaskInfo_t & task = tasks[next_task];
+    task.arrival = arrival;
+    task.target_completion = arrival + 1000000ull * (2 + next_task % 20);
+    return next_task++;
+}
+
+void Stub_SetNow(Time_t time) {
+    now = time;
+}
+
+void Stub_FinishTask(TaskId_t task_id) {
+    VM_RemoveTask(task_vm[task_id], task_id);
+    tasks[task_id].completed = true;
+    tasks[task_id].completion = now;
+    tasks[task_id].remaining_instructions = 0;
+}
+
+// Debugging Interface
+void SimOutput(string msg, unsigned verbose_level) {}
+void ThrowException(string err_msg) { throw runtime_error(err_msg); }
+void ThrowException(string err_msg, string further_input) { throw runtime_error(err_msg + further_input); }
+void ThrowException(string err_msg, unsigned further_input) { throw runtime_error(err_msg + to_string(further_input)); }
+
+// Machine Interface
+CPUType_t Machine_GetCPUType(MachineId_t machine_id) { return machines[machine_id].cpu; }
+uint64_t Machine_GetEnergy(MachineId_t machine_id) { return machines[machine_id].energy_consumed; }
+double Machine_GetClusterEnergy() { return 0; }
+MachineInfo_t Machine_GetInfo(MachineId_t machine_id) { return machines[machine_id]; }
+unsigned Machine_GetTotal() { return machines.size(); }
+
+void Machine_SetCorePerformance(MachineId_t machine_id, unsigned core_id, CPUPerformance_t p_state) {
+    machines[machine_id].p_state = p_state;
+}
+
+void Machine_SetState(MachineId_t machine_id, MachineState_t s_state) {
+    machines[machine_id].s_state = s_state;
+    StateChangeComplete(now, machine_id);
+}
+
+// Statistics
+double GetSLAReport(SLAType_t sla) { return 0; }
+
+// Simulator Interface
+Time_t Now() { return now; }
+
+// Task Interface
+unsigned GetNumTasks() { return tasks.size(); }
+TaskInfo_t GetTaskInfo(TaskId_t task_id) { return tasks[task_id]; }
+unsigned GetTaskMemory(TaskId_t task_id) { return tasks[task_id].required_memory; }
+unsigned GetTaskPriority(TaskId_t task_id) { return tasks[task_id].priority; }
+bool IsSLAViolated(TaskId_t task_id) { return false; }
+bool IsTaskCompleted(TaskId_t task_id) { return tasks[task_id].completed; }
+bool IsTaskGPUCapable(TaskId_t task_id) { return tasks[task_id].gpu_capable; }
+CPUType_t RequiredCPUType(TaskId_t task_id) { return tasks[task_id].required_cpu; }
+SLAType_t RequiredSLA(TaskId_t task_id) { return tasks[task_id].required_sla; }
+VMType_t RequiredVMType(TaskId_t task_id) { return tasks[task_id].required_vm; }
+void SetTaskPriority(TaskId_t task_id, Priority_t priority) { tasks[task_id].priority = priority; }
+TaskClass_t GetTaskClass(TaskId_t task_id) { return WEB_REQUEST; }
+
+// VM Interface
+VMId_t VM_Create(VMType_t vm_type, CPUType_t cpu) {
+    VMId_t vm_id = vms.size();
+    vms.push_back({{}, cpu, 0, vm_id, vm_type});
+    vm_alive.push_back(true);
+    return vm_id;
+}
+
+void VM_Attach(VMId_t vm_id, MachineId_t machine_id) {
+    vms[vm_id].machine_id = machine_id;
+    machines[machine_id].active_vms++;
+    machines[machine_id].memory_used += VM_MEMORY_OVERHEAD;
+}
+
+void VM_AddTask(VMId_t vm_id, TaskId_t task_id, Priority_t priority) {
+    MachineInfo_t & machineInfo = machines[vms[vm_id].machine_id];
+    vms[vm_id].active_tasks.push_back(task_id);
+    machineInfo.active_tasks++;
+    machineInfo.memory_used += tasks[task_id].required_memory;
+    tasks[task_id].priority = priority;
+    task_vm[task_id] = vm_id;
+}
+
+VMInfo_t VM_GetInfo(VMId_t vm_id) { return vms[vm_id]; }
+void VM_Migrate(VMId_t vm_id, MachineId_t machine_id) { ThrowException("VM_Migrate is not stubbed"); }
+
+void VM_RemoveTask(VMId_t vm_id, TaskId_t task_id) {
+    vector<TaskId_t> & active = vms[vm_id].active_tasks;
+    for (auto it = active.begin(); it != active.end(); it++) {
+        if (*it == task_id) {
+            active.erase(it);
+            MachineInfo_t & machineInfo = machines[vms[vm_id].machine_id];
+            machineInfo.active_tasks--;
+            machineInfo.memory_used -= tasks[task_id].required_memory;
+            return;
+        }
+    }
+}
+
+void VM_Shutdown(VMId_t vm_id) {
+    if (!vm_alive[vm_id]) {
+        return;
+    }
+    vm_alive[vm_id] = false;
+    machines[vms[vm_id].machine_id].active_vms--;
+    machines[vms[vm_id].machine_id].memory_used -= VM_MEMORY_OVERHEAD;
+}
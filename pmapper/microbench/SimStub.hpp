@@ -0,0 +1,26 @@
+//
+//  SimStub.hpp
+//  CloudSim
+//
+//  A stand-in for the simulator behind Interfaces.h, so the scheduler can
+//  be driven without it. Machines, VMs and tasks are plain tables; state
+//  changes land immediately (StateChangeComplete is called from inside
+//  Machine_SetState) and no energy is accounted.
+//
+
+#ifndef SimStub_hpp
+#define SimStub_hpp
+
+#include "Interfaces.h"
+
+// num_machines machines and num_tasks tasks, CPU types round robin. task
+// ids are handed out in order by Stub_NextTask
+void        Stub_Setup(unsigned num_machines, unsigned num_tasks);
+TaskId_t    Stub_NextTask(Time_t arrival);
+void        Stub_SetNow(Time_t now);
+
+// what the simulator does before HandleTaskCompletion: takes the task off
+// its VM and machine
+void        Stub_FinishTask(TaskId_t task_id);
+
+#endif /* SimStub_hpp */
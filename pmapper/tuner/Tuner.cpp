@@ -0,0 +1,359 @@
+//
+//  Tuner.cpp
+//  CloudSim
+//
+//  Searches the scheduler's knobs (see registerParams in Scheduler.cpp) by
+//  running the simulator on a set of inputs, many runs at a time. Random
+//  configurations go through successive halving: all of them run on the
+//  first input, the best 1/ETA go on to the first ETA inputs, and so on
+//  until the survivors have run on every input. The best one is written
+//  out as a parameter file, with what it measured next to the defaults.
+//
+//  A run scores energy / (energy with the defaults) + sla_weight times the
+//  SLA0-2 violation percentages, averaged over the inputs it ran; lower is
+//  better, and the defaults score 1 plus their own violations.
+//
+//  usage: tuner [-j jobs] [-n configs] [-w sla_weight] [-s seed]
+//               [-t timeout_sec] [-x simulator] [-d work_dir] [-o best.params]
+//               input.md...
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <string>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+static const unsigned ETA = 3;
+
+typedef enum {
+    BOOL_KNOB,
+    INT_KNOB,
+    REAL_KNOB
+} KnobType_t;
+
+typedef struct {
+    const char * name;
+    KnobType_t type;
+    double low;
+    double high;
+} Knob_t;
+
+// the search space. names are the ones registerParams gives the knobs
+static const Knob_t KNOBS[] = {
+    {"REVERSE_STEP",            INT_KNOB,   1, 4},
+    {"WAKE_PENALTY",            INT_KNOB,   0, 40},
+    {"BROKEN_PENALTY",          INT_KNOB,   0, 2000},
+    {"POWER_DOWN_GATE",         REAL_KNOB,  0, 30},
+    {"SLA_BREACH_FRACTION",     REAL_KNOB,  0.01, 0.2},
+    {"VMS_PER_CORE",            REAL_KNOB,  0.5, 2.0},
+    {"VM_OVERHEAD",             INT_KNOB,   8, 64},     // below 8 overcommits memory
+    {"lookahead_enabled",       BOOL_KNOB,  0, 1},
+    {"LOOKAHEAD_K",             INT_KNOB,   1, 16},
+    {"sla3_deferral_enabled",   BOOL_KNOB,  0, 1},
+    {"SLA3_MAX_DEFERRAL",       INT_KNOB,   5000000, 120000000},
+    {"COMPLETION_SCAN",         INT_KNOB,   1, 64},
+};
+
+// tuning runs write no reports
+static const char * RUN_SETTINGS = "task_report_enabled = false\ntimeline_enabled = false\n";
+
+typedef struct {
+    vector<double> values;          // by KNOBS index, empty for the defaults
+} Config_t;
+
+typedef struct {
+    bool done;
+    bool ok;
+    double energy;                  // KWh
+    double sla[3];                  // percent violated, SLA0-2
+} Result_t;
+
+typedef struct {
+    unsigned jobs;
+    unsigned configs;
+    double sla_weight;
+    unsigned seed;
+    unsigned timeout;
+    string simulator;
+    string work_dir;
+    string output;
+    vector<string> inputs;
+} Options_t;
+
+static string formatValue(const Knob_t & knob, double value) {
+    char buffer[64];
+    if (knob.type == BOOL_KNOB) {
+        return value != 0 ? "true" : "false";
+    } else if (knob.type == INT_KNOB) {
+        snprintf(buffer, sizeof(buffer), "%lld", (long long)value);
+    } else {
+        snprintf(buffer, sizeof(buffer), "%.4g", value);
+    }
+    return buffer;
+}
+
+static Config_t randomConfig(mt19937_64 & random) {
+    Config_t config;
+    for (const Knob_t & knob : KNOBS) {
+        uniform_real_distribution<double> uniform(knob.low, knob.high);
+        double value = uniform(random);
+        if (knob.type == BOOL_KNOB) {
+            value = value >= 0.5;
+        } else if (knob.type == INT_KNOB) {
+            value = round(value);
+        }
+        config.values.push_back(value);
+    }
+    return config;
+}
+
+static void writeConfig(FILE * out, const Config_t & config) {
+    for (unsigned k = 0; k < config.values.size(); k++) {
+        fprintf(out, "%s = %s\n", KNOBS[k].name, formatValue(KNOBS[k], config.values[k]).c_str());
+    }
+}
+
+static bool parseOutput(const string & path, Result_t & result) {
+    FILE * in = fopen(path.c_str(), "r");
+    if (in == nullptr) {
+        return false;
+    }
+    char line[4096];
+    unsigned found = 0;
+    while (fgets(line, sizeof(line), in) != nullptr) {
+        for (unsigned s = 0; s < 3; s++) {
+            char prefix[8];
+            snprintf(prefix, sizeof(prefix), "SLA%u: ", s);
+            if (strncmp(line, prefix, strlen(prefix)) == 0 && sscanf(line + strlen(prefix), "%lf", &result.sla[s]) == 1) {
+                found |= 1 << s;
+            }
+        }
+        if (strncmp(line, "Total Energy ", 13) == 0 && sscanf(line + 13, "%lf", &result.energy) == 1) {
+            found |= 1 << 3;
+        }
+    }
+    fclose(in);
+    return found == 0xf;
+}
+
+// one simulator run in a directory of its own, killed by SIGALRM after the
+// timeout. returns the child's pid
+static pid_t startRun(const Options_t & options, const Config_t & config, unsigned c, unsigned t, string & out_path) {
+    string dir = options.work_dir + "/c" + to_string(c) + "_t" + to_string(t);
+    mkdir(dir.c_str(), 0755);
+    string params_path = dir + "/run.params";
+    out_path = dir + "/out.txt";
+    FILE * params = fopen(params_path.c_str(), "w");
+    if (params != nullptr) {
+        fprintf(params, "%s", RUN_SETTINGS);
+        writeConfig(params, config);
+        fclose(params);
+    }
+
+    pid_t child = fork();
+    if (child == 0) {
+        if (chdir(dir.c_str()) != 0 || freopen("out.txt", "w", stdout) == nullptr || freopen("/dev/null", "w", stderr) == nullptr) {
+            _exit(127);
+        }
+        setenv("PMAPPER_PARAMS", "run.params", 1);
+        alarm(options.timeout);
+        execl(options.simulator.c_str(), options.simulator.c_str(), options.inputs[t].c_str(), (char *)nullptr);
+        _exit(127);
+    }
+    return child;
+}
+
+// runs every (config, input) pair not done yet, options.jobs at a time
+static void runAll(const Options_t & options, const vector<Config_t> & configs, const vector<pair<unsigned, unsigned>> & pairs,
+                   vector<vector<Result_t>> & results) {
+    map<pid_t, pair<unsigned, unsigned>> running;
+    map<pid_t, string> outputs;
+    unsigned next = 0;
+    unsigned finished = 0;
+    while (next < pairs.size() || !running.empty()) {
+        while (next < pairs.size() && running.size() < options.jobs) {
+            unsigned c = pairs[next].first;
+            unsigned t = pairs[next].second;
+            next++;
+            if (results[c][t].done) {
+                continue;
+            }
+            string out_path;
+            pid_t child = startRun(options, configs[c], c, t, out_path);
+            if (child < 0) {
+                results[c][t] = {true, false, 0, {0, 0, 0}};
+                continue;
+            }
+            running[child] = {c, t};
+            outputs[child] = out_path;
+        }
+        if (running.empty()) {
+            break;
+        }
+
+        int status = 0;
+        pid_t child = wait(&status);
+        auto run = running.find(child);
+        if (run == running.end()) {
+            continue;
+        }
+        Result_t & result = results[run->second.first][run->second.second];
+        result = {true, false, 0, {0, 0, 0}};
+        result.ok = WIFEXITED(status) && parseOutput(outputs[child], result);
+        if (result.ok) {
+            unlink(outputs[child].c_str());     // the output of a long input runs to megabytes
+        }
+        running.erase(run);
+        outputs.erase(child);
+        finished++;
+        fprintf(stderr, "\r%u/%zu runs", finished, pairs.size());
+    }
+    fprintf(stderr, "\n");
+}
+
+static double score(const Options_t & options, const vector<Result_t> & results, const vector<Result_t> & defaults, unsigned inputs) {
+    double total = 0;
+    for (unsigned t = 0; t < inputs; t++) {
+        const Result_t & result = results[t];
+        if (!result.ok || !defaults[t].ok || defaults[t].energy <= 0) {
+            return INFINITY;
+        }
+        total += result.energy / defaults[t].energy + options.sla_weight * (result.sla[0] + result.sla[1] + result.sla[2]);
+    }
+    return total / inputs;
+}
+
+static void usage() {
+    fprintf(stderr, "usage: tuner [-j jobs] [-n configs] [-w sla_weight] [-s seed] [-t timeout_sec]\n"
+                    "             [-x simulator] [-d work_dir] [-o best.params] input.md...\n");
+    exit(2);
+}
+
+static string absolute(const string & path) {
+    char * resolved = realpath(path.c_str(), nullptr);
+    if (resolved == nullptr) {
+        fprintf(stderr, "tuner: cannot find %s\n", path.c_str());
+        exit(2);
+    }
+    string result = resolved;
+    free(resolved);
+    return result;
+}
+
+int main(int argc, char * argv[]) {
+    Options_t options = {max(1u, thread::hardware_concurrency()), 27, 0.05, 1, 600, "./simulator", "tune_runs", "best.params", {}};
+    int opt;
+    while ((opt = getopt(argc, argv, "j:n:w:s:t:x:d:o:")) != -1) {
+        switch (opt) {
+            case 'j': options.jobs = max(1, atoi(optarg)); break;
+            case 'n': options.configs = max(1, atoi(optarg)); break;
+            case 'w': options.sla_weight = atof(optarg); break;
+            case 's': options.seed = (unsigned)atoi(optarg); break;
+            case 't': options.timeout = max(1, atoi(optarg)); break;
+            case 'x': options.simulator = optarg; break;
+            case 'd': options.work_dir = optarg; break;
+            case 'o': options.output = optarg; break;
+            default: usage();
+        }
+    }
+    for (int i = optind; i < argc; i++) {
+        options.inputs.push_back(absolute(argv[i]));
+    }
+    if (options.inputs.empty()) {
+        usage();
+    }
+    options.simulator = absolute(options.simulator);
+    mkdir(options.work_dir.c_str(), 0755);
+    options.work_dir = absolute(options.work_dir);
+
+    // config 0 is the defaults, everything is measured against it
+    mt19937_64 random(options.seed);
+    vector<Config_t> configs = {{}};
+    for (unsigned c = 0; c < options.configs; c++) {
+        configs.push_back(randomConfig(random));
+    }
+    unsigned inputs = options.inputs.size();
+    vector<vector<Result_t>> results(configs.size(), vector<Result_t>(inputs, {false, false, 0, {0, 0, 0}}));
+
+    // the defaults on every input first. this also leaves each input's
+    // workload image in place before runs of the same input start together
+    vector<pair<unsigned, unsigned>> pairs;
+    for (unsigned t = 0; t < inputs; t++) {
+        pairs.push_back({0, t});
+    }
+    fprintf(stderr, "defaults on %u inputs\n", inputs);
+    runAll(options, configs, pairs, results);
+    for (unsigned t = 0; t < inputs; t++) {
+        if (!results[0][t].ok) {
+            fprintf(stderr, "tuner: the defaults failed on %s\n", options.inputs[t].c_str());
+            return 1;
+        }
+    }
+
+    // successive halving over the random configs
+    vector<unsigned> alive;
+    for (unsigned c = 1; c < configs.size(); c++) {
+        alive.push_back(c);
+    }
+    unsigned rung_inputs = 1;
+    while (true) {
+        rung_inputs = min(rung_inputs, inputs);
+        pairs.clear();
+        for (unsigned t = 0; t < rung_inputs; t++) {
+            for (unsigned c : alive) {
+                pairs.push_back({c, t});
+            }
+        }
+        fprintf(stderr, "%zu configs on %u inputs\n", alive.size(), rung_inputs);
+        runAll(options, configs, pairs, results);
+
+        sort(alive.begin(), alive.end(), [&](unsigned a, unsigned b) {
+            return score(options, results[a], results[0], rung_inputs) < score(options, results[b], results[0], rung_inputs);
+        });
+        if (rung_inputs == inputs) {
+            break;
+        }
+        alive.resize(max<size_t>(1, alive.size() / ETA));
+        rung_inputs *= ETA;
+    }
+
+    unsigned best = alive.empty() ? 0 : alive.front();
+    double defaultScore = score(options, results[0], results[0], inputs);
+    double bestScore = score(options, results[best], results[0], inputs);
+    if (!(bestScore < defaultScore)) {
+        best = 0;
+        bestScore = defaultScore;
+    }
+
+    FILE * out = fopen(options.output.c_str(), "w");
+    if (out == nullptr) {
+        fprintf(stderr, "tuner: cannot write %s\n", options.output.c_str());
+        return 1;
+    }
+    fprintf(out, "# tuned over %u inputs, %u random configs, seed %u\n", inputs, options.configs, options.seed);
+    fprintf(out, "# score = energy / default energy + %g * (SLA0 + SLA1 + SLA2 %%), lower is better\n", options.sla_weight);
+    fprintf(out, "# score %.4f, defaults %.4f%s\n", bestScore, defaultScore, best == 0 ? " (nothing beat the defaults)" : "");
+    for (unsigned t = 0; t < inputs; t++) {
+        const Result_t & tuned = results[best][t];
+        const Result_t & base = results[0][t];
+        fprintf(out, "# %s: %.6g KWh, SLA0 %.3g%% SLA1 %.3g%% SLA2 %.3g%% (defaults %.6g KWh, SLA0 %.3g%% SLA1 %.3g%% SLA2 %.3g%%)\n",
+                options.inputs[t].c_str(), tuned.energy, tuned.sla[0], tuned.sla[1], tuned.sla[2],
+                base.energy, base.sla[0], base.sla[1], base.sla[2]);
+    }
+    writeConfig(out, configs[best]);
+    fclose(out);
+
+    printf("best score %.4f (defaults %.4f), written to %s\n", bestScore, defaultScore, options.output.c_str());
+    return 0;
+}